@@ -0,0 +1,372 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      FixedMatrix.hpp
+//
+// Author:         Sahib Pandori and Haylee Monteiro
+// CS email:       sahib@cs.wisc.edu and haylee@cs.wisc.edu
+//
+// Description:    This file contains the compile-time sized matrix, meant for
+//                 the small (2x2 to 4x4) matrices used in geometry code
+///////////////////////////////////////////////////////////////////////////////
+#ifndef FIXED_MATRIX_H
+#define FIXED_MATRIX_H
+
+#include <ostream>
+
+#include "Matrix.hpp"
+
+namespace matrix_kernels {
+
+// Compile-time list of element indices, expanded to unroll fixed-size loops
+template <int... I>
+struct IndexList {};
+
+template <int N, int... I>
+struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {};
+
+template <int... I>
+struct MakeIndexList<0, I...> {
+    typedef IndexList<I...> type;
+};
+
+// Logical and of any number of booleans, usable in constant expressions
+constexpr bool allOf() {
+    return true;
+}
+
+template <typename... B>
+constexpr bool allOf(bool b, B... rest) {
+    return b && allOf(rest...);
+}
+
+} // namespace matrix_kernels
+
+/**
+ * @brief Matrix whose dimensions are template parameters. Storage is a plain
+ *        array inside the object, so there is no heap allocation, and shape
+ *        mismatches are compile errors instead of IncompatibleMatrices. The
+ *        value-returning operators are constexpr and fully unrolled
+ *
+ * It is an aggregate, so it can be brace initialized row by row:
+ *     FixedMatrix<int, 2, 2> m = {{1, 2, 3, 4}};
+ * and FixedMatrix<int, 2, 2> m{} is all zeros
+ */
+template <typename T, int R, int C>
+struct FixedMatrix {
+    static_assert(R > 0 && C > 0, "FixedMatrix dimensions must be positive");
+
+    // Type of the elements
+    typedef T value_type;
+
+    // Elements in row-major order (public so the type stays an aggregate)
+    T elems[R * C];
+
+    /**
+     * @brief Returns the number of rows in the matrix
+     *
+     * @return number of rows
+     */
+    static constexpr int getRows() {
+        return R;
+    }
+
+    /**
+     * @brief Returns the number of columns in the matrix
+     *
+     * @return number of columns
+     */
+    static constexpr int getCols() {
+        return C;
+    }
+
+    /**
+     * @brief Overloading the array index operator. There is no bounds
+     *        checking, as with a built-in two dimensional array
+     *
+     * @param index : the row to be accessed
+     * @return pointer to the first element of the row
+     */
+    T *operator[](const int index) & {
+        return elems + index * C;
+    }
+
+    constexpr const T *operator[](const int index) const & {
+        return elems + index * C;
+    }
+
+    /**
+     * @brief Returns the element at row i, column j
+     *
+     * @param i : row of the element
+     * @param j : column of the element
+     * @return the value of the element
+     */
+    constexpr T operator()(const int i, const int j) const {
+        return elems[i * C + j];
+    }
+
+    /**
+     * @brief Converts to a dynamically sized Matrix
+     *
+     * @return a Matrix holding the same elements
+     */
+    operator Matrix<T>() const {
+        Matrix<T> ret(R, C);
+        for (int i = 0; i < R; ++i) {
+            for (int j = 0; j < C; ++j) {
+                ret.rowData(i)[j] = elems[i * C + j];
+            }
+        }
+        return ret;
+    }
+
+    /**
+     * @brief Copies a dynamically sized Matrix of the same shape
+     *
+     * @param m : the matrix to be copied
+     * @return a FixedMatrix holding the same elements
+     */
+    static FixedMatrix fromMatrix(const Matrix<T> &m) {
+        if (m.getRows() != R || m.getCols() != C) {
+            throw IncompatibleMatrices('=', R, C, m.getRows(), m.getCols());
+        }
+        FixedMatrix ret;
+        for (int i = 0; i < R; ++i) {
+            for (int j = 0; j < C; ++j) {
+                ret.elems[i * C + j] = m.rowData(i)[j];
+            }
+        }
+        return ret;
+    }
+
+    FixedMatrix &operator+=(const FixedMatrix &m) {
+        for (int i = 0; i < R * C; ++i) {
+            elems[i] += m.elems[i];
+        }
+        return *this;
+    }
+
+    FixedMatrix &operator-=(const FixedMatrix &m) {
+        for (int i = 0; i < R * C; ++i) {
+            elems[i] -= m.elems[i];
+        }
+        return *this;
+    }
+
+    FixedMatrix &operator*=(const T &c) {
+        for (int i = 0; i < R * C; ++i) {
+            elems[i] *= c;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Overloading the multiplication assignment operator. Only square
+     *        right operands keep the shape, anything else does not compile
+     *
+     * @param m : the matrix to be multiplied to the calling object
+     * @return reference to the calling object after m has been multiplied to it
+     */
+    FixedMatrix &operator*=(const FixedMatrix<T, C, C> &m);
+};
+
+namespace matrix_kernels {
+
+template <typename T, int R, int C, int... I>
+constexpr FixedMatrix<T, R, C> fixedAdd(const FixedMatrix<T, R, C> &a,
+                                        const FixedMatrix<T, R, C> &b,
+                                        IndexList<I...>) {
+    return FixedMatrix<T, R, C>{{(a.elems[I] + b.elems[I])...}};
+}
+
+template <typename T, int R, int C, int... I>
+constexpr FixedMatrix<T, R, C> fixedSub(const FixedMatrix<T, R, C> &a,
+                                        const FixedMatrix<T, R, C> &b,
+                                        IndexList<I...>) {
+    return FixedMatrix<T, R, C>{{(a.elems[I] - b.elems[I])...}};
+}
+
+template <typename T, int R, int C, int... I>
+constexpr FixedMatrix<T, R, C> fixedScale(const FixedMatrix<T, R, C> &a,
+                                          const T &c, IndexList<I...>) {
+    return FixedMatrix<T, R, C>{{(a.elems[I] * c)...}};
+}
+
+template <typename T, int R, int C, int... I>
+constexpr bool fixedEqual(const FixedMatrix<T, R, C> &a,
+                          const FixedMatrix<T, R, C> &b, IndexList<I...>) {
+    return allOf((a.elems[I] == b.elems[I])...);
+}
+
+// Dot product of row i of a and column j of b over k = 0 .. P, unrolled
+// by template recursion and summed in increasing k like the dynamic kernels
+template <int P>
+struct FixedDot {
+    template <typename T, int R, int K, int C>
+    static constexpr T run(const FixedMatrix<T, R, K> &a,
+                           const FixedMatrix<T, K, C> &b, int i, int j) {
+        return FixedDot<P - 1>::run(a, b, i, j)
+               + a.elems[i * K + P] * b.elems[P * C + j];
+    }
+};
+
+template <>
+struct FixedDot<0> {
+    template <typename T, int R, int K, int C>
+    static constexpr T run(const FixedMatrix<T, R, K> &a,
+                           const FixedMatrix<T, K, C> &b, int i, int j) {
+        return a.elems[i * K] * b.elems[j];
+    }
+};
+
+template <typename T, int R, int K, int C, int... I>
+constexpr FixedMatrix<T, R, C> fixedMultiply(const FixedMatrix<T, R, K> &a,
+                                             const FixedMatrix<T, K, C> &b,
+                                             IndexList<I...>) {
+    return FixedMatrix<T, R, C>{{FixedDot<K - 1>::run(a, b, I / C, I % C)...}};
+}
+
+} // namespace matrix_kernels
+
+/**
+ * @brief Overloading the addition operator for FixedMatrix
+ *
+ * @param a : the left operand
+ * @param b : the right operand, which must have the same shape
+ * @return the sum of a and b
+ */
+template <typename T, int R, int C>
+constexpr FixedMatrix<T, R, C> operator+(const FixedMatrix<T, R, C> &a,
+                                         const FixedMatrix<T, R, C> &b) {
+    return matrix_kernels::fixedAdd(
+        a, b, typename matrix_kernels::MakeIndexList<R * C>::type());
+}
+
+/**
+ * @brief Overloading the subtraction operator for FixedMatrix
+ *
+ * @param a : the left operand
+ * @param b : the operand to be subtracted from a, of the same shape
+ * @return the difference between a and b
+ */
+template <typename T, int R, int C>
+constexpr FixedMatrix<T, R, C> operator-(const FixedMatrix<T, R, C> &a,
+                                         const FixedMatrix<T, R, C> &b) {
+    return matrix_kernels::fixedSub(
+        a, b, typename matrix_kernels::MakeIndexList<R * C>::type());
+}
+
+/**
+ * @brief Overloading the multiplication operator for FixedMatrix. The inner
+ *        dimensions have to agree at compile time
+ *
+ * @param a : an R x K matrix
+ * @param b : a K x C matrix
+ * @return the R x C product of a and b
+ */
+template <typename T, int R, int K, int C>
+constexpr FixedMatrix<T, R, C> operator*(const FixedMatrix<T, R, K> &a,
+                                         const FixedMatrix<T, K, C> &b) {
+    return matrix_kernels::fixedMultiply(
+        a, b, typename matrix_kernels::MakeIndexList<R * C>::type());
+}
+
+/**
+ * @brief Overloading the multiplication operator (with scalars) for
+ *        FixedMatrix
+ *
+ * @param a : the matrix to be multiplied with the scalar
+ * @param c : the scalar to be multiplied with the matrix
+ * @return the product of the matrix and the scalar
+ */
+template <typename T, int R, int C>
+constexpr FixedMatrix<T, R, C> operator*(
+        const FixedMatrix<T, R, C> &a,
+        typename FixedMatrix<T, R, C>::value_type c) {
+    return matrix_kernels::fixedScale(
+        a, c, typename matrix_kernels::MakeIndexList<R * C>::type());
+}
+
+template <typename T, int R, int C>
+constexpr FixedMatrix<T, R, C> operator*(
+        typename FixedMatrix<T, R, C>::value_type c,
+        const FixedMatrix<T, R, C> &a) {
+    return a * c;
+}
+
+template <typename T, int R, int C>
+constexpr bool operator==(const FixedMatrix<T, R, C> &a,
+                          const FixedMatrix<T, R, C> &b) {
+    return matrix_kernels::fixedEqual(
+        a, b, typename matrix_kernels::MakeIndexList<R * C>::type());
+}
+
+template <typename T, int R, int C>
+constexpr bool operator!=(const FixedMatrix<T, R, C> &a,
+                          const FixedMatrix<T, R, C> &b) {
+    return !(a == b);
+}
+
+template <typename T, int R, int C>
+FixedMatrix<T, R, C> &FixedMatrix<T, R, C>::operator*=(
+        const FixedMatrix<T, C, C> &m) {
+    *this = *this * m;
+    return *this;
+}
+
+/**
+ * @brief Mixed operations with the dynamically sized Matrix. These convert
+ *        the FixedMatrix and check shapes at run time, throwing
+ *        IncompatibleMatrices like the Matrix operators do
+ */
+template <typename T, int R, int C>
+Matrix<T> operator+(const FixedMatrix<T, R, C> &a, const Matrix<T> &b) {
+    return Matrix<T>(a) + b;
+}
+
+template <typename T, int R, int C>
+Matrix<T> operator+(const Matrix<T> &a, const FixedMatrix<T, R, C> &b) {
+    return a + Matrix<T>(b);
+}
+
+template <typename T, int R, int C>
+Matrix<T> operator-(const FixedMatrix<T, R, C> &a, const Matrix<T> &b) {
+    return Matrix<T>(a) - b;
+}
+
+template <typename T, int R, int C>
+Matrix<T> operator-(const Matrix<T> &a, const FixedMatrix<T, R, C> &b) {
+    return a - Matrix<T>(b);
+}
+
+template <typename T, int R, int C>
+Matrix<T> operator*(const FixedMatrix<T, R, C> &a, const Matrix<T> &b) {
+    return Matrix<T>(a) * b;
+}
+
+template <typename T, int R, int C>
+Matrix<T> operator*(const Matrix<T> &a, const FixedMatrix<T, R, C> &b) {
+    return a * Matrix<T>(b);
+}
+
+/**
+ * @brief Overloading the stream extraction operator to print FixedMatrix,
+ *        in the same format as Matrix. Rows end in '\n' and the stream is
+ *        flushed once at the end
+ *
+ * @param o : the output stream to print the output to
+ * @param m : the matrix to be printed
+ * @return reference to the output stream after the matrix has been printed
+ */
+template <typename T, int R, int C>
+std::ostream &operator<<(std::ostream &o, const FixedMatrix<T, R, C> &m) {
+    for (int i = 0; i < R; ++i) {
+        for (int j = 0; j < C; ++j) {
+            (j == C - 1) ? o << m(i, j) : o << m(i, j) << " ";
+        }
+        o << '\n';
+    }
+    o.flush();
+    return o;
+}
+
+#endif
@@ -11,9 +11,23 @@
 #define MATRIX_H
 
 #include <algorithm>
+#include <atomic>
 #include <vector>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <exception>
+#include <functional>
+#include <initializer_list>
+#include <new>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "MatrixFormat.hpp"
+#include "MatrixKernels.hpp"
+#include "ThreadPool.hpp"
 
 class InvalidDimension : public std::exception {
 private:
@@ -86,6 +100,9 @@ public:
             case '*':
                 exception += "Multiplication ";
                 break;
+            case '=':
+                exception += "Conversion ";
+                break;
             default:
                 exception += "Undefined operation ";
                 break;
@@ -100,17 +117,614 @@ public:
 };
 
 
+/**
+ * @brief Allocator handing out blocks aligned to Align bytes (a cache line by
+ *        default), so that every row of a Matrix can start on a cache line
+ *        boundary. It is the default for the Alloc parameter of Matrix; any
+ *        standard allocator works there, but only aligned ones keep rows on
+ *        cache line boundaries (see PoolAllocator in MatrixPool.hpp)
+ */
+template <typename T, std::size_t Align = 64>
+struct AlignedAllocator {
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef AlignedAllocator<U, Align> other;
+    };
+
+    AlignedAllocator() {}
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Align> &) {}
+
+    T *allocate(std::size_t n) {
+        // Over-allocate and stash the raw pointer right before the aligned
+        // block so deallocate() can hand it back to operator delete
+        void *raw = ::operator new(n * sizeof(T) + Align + sizeof(void *));
+        std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(raw)
+                              + sizeof(void *);
+        addr = (addr + Align - 1) & ~(std::uintptr_t) (Align - 1);
+        reinterpret_cast<void **>(addr)[-1] = raw;
+        return reinterpret_cast<T *>(addr);
+    }
+
+    void deallocate(T *p, std::size_t) {
+        if (p != nullptr) {
+            ::operator delete(reinterpret_cast<void **>(p)[-1]);
+        }
+    }
+};
+
+template <typename T, typename U, std::size_t Align>
+bool operator==(const AlignedAllocator<T, Align> &,
+                const AlignedAllocator<U, Align> &) {
+    return true;
+}
+
+template <typename T, typename U, std::size_t Align>
+bool operator!=(const AlignedAllocator<T, Align> &,
+                const AlignedAllocator<U, Align> &) {
+    return false;
+}
+
+/**
+ * @brief Lightweight, non-owning view of a single row of a Matrix. Supports
+ *        m[i][j] style access without exposing the underlying storage
+ */
+template <typename U>
+class MatrixRow {
+private:
+    // First element of the row
+    U *first;
+    // Number of elements in the row
+    int length;
+public:
+    MatrixRow(U *p, int n) : first(p), length(n) {}
+
+    // Allow a mutable row to be passed where a const row is expected
+    template <typename V>
+    MatrixRow(const MatrixRow<V> &r) : first(r.begin()), length(r.size()) {}
+
+    U &operator[](const int index) const {
+        return first[index];
+    }
+
+    int size() const {
+        return length;
+    }
+
+    U *begin() const {
+        return first;
+    }
+
+    U *end() const {
+        return first + length;
+    }
+};
+
+/**
+ * @brief Bounds checking policies for Matrix::operator[], passed as the second
+ *        template parameter of Matrix. at() always checks and operator()
+ *        never does, whatever the policy
+ */
+// Every access is checked and throws IndexOutOfBounds (the default)
+struct CheckedAccess {
+    static const bool enabled = true;
+};
+
+// Checked like CheckedAccess, unless NDEBUG is defined
+struct DebugCheckedAccess {
+#ifdef NDEBUG
+    static const bool enabled = false;
+#else
+    static const bool enabled = true;
+#endif
+};
+
+// Never checked, like a built-in array
+struct UncheckedAccess {
+    static const bool enabled = false;
+};
+/**
+ * @brief Sets the number of threads used by the parallel Matrix kernels,
+ *        including the calling thread
+ *
+ * @param n : number of threads, 1 disables multithreading
+ */
+inline void setMatrixThreads(int n) {
+    ThreadPool::instance().setThreadCount(n);
+}
+
+/**
+ * @brief Returns the number of threads used by the parallel Matrix kernels
+ *
+ * @return number of threads
+ */
+inline int getMatrixThreads() {
+    return ThreadPool::instance().getThreadCount();
+}
+
+/**
+ * @brief Sets the size below which matrix multiplication stays on the calling
+ *        thread
+ *
+ * @param multiplyAdds : rows * inner dimension * columns of the product
+ */
+inline void setMatrixParallelCutoff(long multiplyAdds) {
+    matrix_kernels::ParallelConfig::gemmCutoff() = multiplyAdds;
+}
+
+/**
+ * @brief Returns the size below which matrix multiplication stays on the
+ *        calling thread
+ *
+ * @return the cutoff in multiply-adds (rows * inner dimension * columns)
+ */
+inline long getMatrixParallelCutoff() {
+    return matrix_kernels::ParallelConfig::gemmCutoff();
+}
+
+/**
+ * @brief Sets the size below which printing a matrix formats its text on the
+ *        calling thread. Larger matrices are formatted a block of rows per
+ *        thread and written in order
+ *
+ * @param elements : rows * columns of the printed matrix
+ */
+inline void setMatrixPrintCutoff(long elements) {
+    matrix_kernels::ParallelConfig::printCutoff() = elements;
+}
+
+/**
+ * @brief Returns the size below which printing a matrix stays on the calling
+ *        thread
+ *
+ * @return the cutoff in elements (rows * columns)
+ */
+inline long getMatrixPrintCutoff() {
+    return matrix_kernels::ParallelConfig::printCutoff();
+}
+
+/**
+ * @brief Sets the size below which element-wise operations (+, -, scalar *,
+ *        their compound forms and ==) stay on the calling thread. Larger
+ *        matrices are split into ranges of rows computed in parallel
+ *
+ * @param elements : rows * columns of the operands
+ */
+inline void setMatrixElementwiseCutoff(long elements) {
+    matrix_kernels::ParallelConfig::elementwiseCutoff() = elements;
+}
+
+/**
+ * @brief Returns the size below which element-wise operations stay on the
+ *        calling thread
+ *
+ * @return the cutoff in elements (rows * columns)
+ */
+inline long getMatrixElementwiseCutoff() {
+    return matrix_kernels::ParallelConfig::elementwiseCutoff();
+}
+
+/**
+ * @brief Block of memory an expression is evaluated into (or read from),
+ *        used to detect aliasing between the two
+ */
+struct ExprTarget {
+    // Address of element (0, 0) and one past the last element
+    std::uintptr_t origin;
+    std::uintptr_t end;
+    // Distance between the starts of two consecutive rows, in bytes
+    std::size_t rowBytes;
+
+    template <typename T>
+    static ExprTarget of(const T *first, int rows, int cols, int stride) {
+        ExprTarget ret;
+        ret.origin = reinterpret_cast<std::uintptr_t>(first);
+        ret.end = ret.origin;
+        if (rows > 0 && cols > 0) {
+            ret.end += ((std::size_t) (rows - 1) * stride + cols) * sizeof(T);
+        }
+        ret.rowBytes = (std::size_t) stride * sizeof(T);
+        return ret;
+    }
+
+    // True if the two blocks share any memory
+    bool overlaps(const ExprTarget &o) const {
+        return origin < o.end && o.origin < end;
+    }
+
+    // True if the blocks share memory at positions that do not line up, so
+    // writing one element may change another element still to be read
+    bool overlapsShifted(const ExprTarget &o) const {
+        return overlaps(o) && (origin != o.origin || rowBytes != o.rowBytes);
+    }
+};
+
+/**
+ * @brief Base of every matrix expression (CRTP). An expression E provides
+ *        value_type, getRows(), getCols(), rowData(i) and mayAlias(t), where
+ *        rowData(i) returns something indexable by column that yields the
+ *        values of row i, and mayAlias(t) is true if evaluating E into the
+ *        storage t would read elements of t from other positions than the
+ *        one being written. Matrix and MatrixView are the dense leaves, whose
+ *        rowData(i) is a plain pointer
+ */
+template <typename E>
+struct MatrixExpr {
+    const E &self() const {
+        return static_cast<const E &>(*this);
+    }
+};
+
+/**
+ * @brief How an expression node stores its operands: nested expressions are
+ *        small and held by value, Matrix leaves are held by reference
+ */
+template <typename E>
+struct ExprOperand {
+    typedef const E type;
+};
+
+// Element-wise operations used by MatrixBinaryExpr
+struct AddOp {
+    static const char symbol = '+';
+    template <typename T>
+    static T apply(const T &a, const T &b) {
+        return a + b;
+    }
+};
+
+struct SubOp {
+    static const char symbol = '-';
+    template <typename T>
+    static T apply(const T &a, const T &b) {
+        return a - b;
+    }
+};
+
+/**
+ * @brief Lazy element-wise combination of two expressions of equal shape.
+ *        The shapes are checked when the node is built, so mismatches throw
+ *        at the operator just like an eager implementation would
+ */
+template <typename Op, typename L, typename R>
+class MatrixBinaryExpr : public MatrixExpr<MatrixBinaryExpr<Op, L, R>> {
+private:
+    typename ExprOperand<L>::type lhs;
+    typename ExprOperand<R>::type rhs;
+public:
+    typedef typename L::value_type value_type;
+
+    // Values of one row, computed on demand
+    struct Row {
+        decltype(std::declval<const L &>().rowData(0)) l;
+        decltype(std::declval<const R &>().rowData(0)) r;
+
+        value_type operator[](const int j) const {
+            return Op::apply(value_type(l[j]), value_type(r[j]));
+        }
+    };
+
+    MatrixBinaryExpr(const L &l, const R &r) : lhs(l), rhs(r) {
+        if (l.getRows() != r.getRows() || l.getCols() != r.getCols()) {
+            throw IncompatibleMatrices(Op::symbol, l.getRows(), l.getCols(),
+                                       r.getRows(), r.getCols());
+        }
+    }
+
+    int getRows() const {
+        return lhs.getRows();
+    }
+
+    int getCols() const {
+        return lhs.getCols();
+    }
+
+    const L &left() const {
+        return lhs;
+    }
+
+    const R &right() const {
+        return rhs;
+    }
+
+    bool mayAlias(const ExprTarget &target) const {
+        return lhs.mayAlias(target) || rhs.mayAlias(target);
+    }
+
+    Row rowData(const int index) const {
+        Row ret = {lhs.rowData(index), rhs.rowData(index)};
+        return ret;
+    }
+};
+
+/**
+ * @brief Lazy product of an expression and a scalar
+ */
+template <typename E>
+class MatrixScaleExpr : public MatrixExpr<MatrixScaleExpr<E>> {
+private:
+    typename ExprOperand<E>::type operand;
+    typename E::value_type factor;
+public:
+    typedef typename E::value_type value_type;
+
+    // Values of one row, computed on demand
+    struct Row {
+        decltype(std::declval<const E &>().rowData(0)) in;
+        value_type c;
+
+        value_type operator[](const int j) const {
+            return in[j] * c;
+        }
+    };
+
+    MatrixScaleExpr(const E &e, const value_type &c) : operand(e), factor(c) {}
+
+    int getRows() const {
+        return operand.getRows();
+    }
+
+    int getCols() const {
+        return operand.getCols();
+    }
+
+    const E &inner() const {
+        return operand;
+    }
+
+    const value_type &scalar() const {
+        return factor;
+    }
+
+    bool mayAlias(const ExprTarget &target) const {
+        return operand.mayAlias(target);
+    }
+
+    Row rowData(const int index) const {
+        Row ret = {operand.rowData(index), factor};
+        return ret;
+    }
+};
+
+/**
+ * @brief Overloading the addition operator for Matrix expressions. Nothing is
+ *        computed until the result is assigned to a Matrix
+ *
+ * @param l : the left operand
+ * @param r : the right operand
+ * @return a lazy expression for the sum of l and r
+ */
+template <typename L, typename R>
+MatrixBinaryExpr<AddOp, L, R> operator+(const MatrixExpr<L> &l,
+                                        const MatrixExpr<R> &r) {
+    return MatrixBinaryExpr<AddOp, L, R>(l.self(), r.self());
+}
+
+/**
+ * @brief Overloading the subtraction operator for Matrix expressions. Nothing
+ *        is computed until the result is assigned to a Matrix
+ *
+ * @param l : the left operand
+ * @param r : the operand to be subtracted from l
+ * @return a lazy expression for the difference between l and r
+ */
+template <typename L, typename R>
+MatrixBinaryExpr<SubOp, L, R> operator-(const MatrixExpr<L> &l,
+                                        const MatrixExpr<R> &r) {
+    return MatrixBinaryExpr<SubOp, L, R>(l.self(), r.self());
+}
+
+/**
+ * @brief Overloading the multiplication operator (with scalars) for Matrix
+ *        expressions. Nothing is computed until the result is assigned to a
+ *        Matrix
+ *
+ * @param m : the expression to be multiplied with the scalar
+ * @param c : the scalar to be multiplied with the expression
+ * @return a lazy expression for the product of the expression and the scalar
+ */
+template <typename E>
+MatrixScaleExpr<E> operator*(const MatrixExpr<E> &m,
+                             typename E::value_type c) {
+    return MatrixScaleExpr<E>(m.self(), c);
+}
+
+/**
+ * @brief Overloading the multiplication operator (with scalars) for Matrix
+ *        expressions. Nothing is computed until the result is assigned to a
+ *        Matrix
+ *
+ * @param c : the scalar to be multiplied with the expression
+ * @param m : the expression to be multiplied with the scalar
+ * @return a lazy expression for the product of the expression and the scalar
+ */
+template <typename E>
+MatrixScaleExpr<E> operator*(typename E::value_type c,
+                             const MatrixExpr<E> &m) {
+    return MatrixScaleExpr<E>(m.self(), c);
+}
+
+template <typename T, typename Check = CheckedAccess,
+          typename Alloc = AlignedAllocator<T>>
+class Matrix;
+
+template <typename T, typename Check, typename Alloc>
+class TransposeView;
+
+template <typename U, typename Check>
+class MatrixView;
+
+template <typename T, typename Check, typename Alloc>
+struct ExprOperand<Matrix<T, Check, Alloc>> {
+    typedef const Matrix<T, Check, Alloc> &type;
+};
+
+/**
+ * @brief Evaluates one row of an expression into a buffer in a single fused
+ *        loop. Specialized below so the simplest expressions reuse the
+ *        vectorized element-wise kernels
+ */
+template <typename E>
+struct ExprEvaluator {
+    template <typename T>
+    static void evalRow(const E &e, int i, T *out, int n) {
+        const auto in = e.rowData(i);
+        for (int j = 0; j < n; ++j) {
+            out[j] = in[j];
+        }
+    }
+};
+
+/**
+ * @brief Row kernels behind the specialized evaluators. When both operands
+ *        are dense leaves (Matrix, MatrixView) their rows are plain pointers
+ *        and go to the vectorized element-wise kernels. Anything else falls
+ *        back to a fused loop over the expression's own row. Callers pass
+ *        operand rows through constRow(), since the rows of writable views
+ *        are T * and would otherwise prefer the generic overloads
+ */
+struct RowOps {
+    template <typename T>
+    static const T *constRow(T *row) {
+        return row;
+    }
+
+    template <typename Row>
+    static const Row &constRow(const Row &row) {
+        return row;
+    }
+
+    template <typename T, typename Row>
+    static void add(const T *a, const T *b, const Row &, T *out, int n) {
+        matrix_kernels::ElementwiseDispatch<T>::add(a, b, out, n);
+    }
+
+    template <typename T, typename Row>
+    static void sub(const T *a, const T *b, const Row &, T *out, int n) {
+        matrix_kernels::ElementwiseDispatch<T>::sub(a, b, out, n);
+    }
+
+    template <typename T, typename Row>
+    static void scale(const T *a, const T &c, const Row &, T *out, int n) {
+        matrix_kernels::ElementwiseDispatch<T>::scale(a, c, out, n);
+    }
+
+    template <typename A, typename B, typename Row, typename T>
+    static void add(const A &, const B &, const Row &row, T *out, int n) {
+        fused(row, out, n);
+    }
+
+    template <typename A, typename B, typename Row, typename T>
+    static void sub(const A &, const B &, const Row &row, T *out, int n) {
+        fused(row, out, n);
+    }
+
+    template <typename A, typename B, typename Row, typename T>
+    static void scale(const A &, const B &, const Row &row, T *out, int n) {
+        fused(row, out, n);
+    }
+
+    template <typename Row, typename T>
+    static void fused(const Row &row, T *out, int n) {
+        for (int j = 0; j < n; ++j) {
+            out[j] = row[j];
+        }
+    }
+
+    template <typename T>
+    static bool equal(const T *a, const T *b, int n) {
+        return matrix_kernels::ElementwiseDispatch<T>::equal(a, b, n);
+    }
+
+    template <typename A, typename B>
+    static bool equal(const A &a, const B &b, int n) {
+        for (int j = 0; j < n; ++j) {
+            if (!(a[j] == b[j]))
+                return false;
+        }
+        return true;
+    }
+};
+
+template <typename L, typename R>
+struct ExprEvaluator<MatrixBinaryExpr<AddOp, L, R>> {
+    template <typename T>
+    static void evalRow(const MatrixBinaryExpr<AddOp, L, R> &e, int i, T *out,
+                        int n) {
+        RowOps::add(RowOps::constRow(e.left().rowData(i)),
+                    RowOps::constRow(e.right().rowData(i)), e.rowData(i), out,
+                    n);
+    }
+};
+
+template <typename L, typename R>
+struct ExprEvaluator<MatrixBinaryExpr<SubOp, L, R>> {
+    template <typename T>
+    static void evalRow(const MatrixBinaryExpr<SubOp, L, R> &e, int i, T *out,
+                        int n) {
+        RowOps::sub(RowOps::constRow(e.left().rowData(i)),
+                    RowOps::constRow(e.right().rowData(i)), e.rowData(i), out,
+                    n);
+    }
+};
+
+template <typename E>
+struct ExprEvaluator<MatrixScaleExpr<E>> {
+    template <typename T>
+    static void evalRow(const MatrixScaleExpr<E> &e, int i, T *out, int n) {
+        RowOps::scale(RowOps::constRow(e.inner().rowData(i)), e.scalar(),
+                      e.rowData(i), out, n);
+    }
+};
 
-template<typename T>
-class Matrix {
+template <typename T, typename Check, typename Alloc>
+class Matrix : public MatrixExpr<Matrix<T, Check, Alloc>> {
 private:
     // Number of rows in the matrix
     int row;
     // Number of columns in the matrix
     int col;
-    // Data structure that holds all the values of the matrix
-    std::vector<std::vector<T>> data;
+    // Distance (in elements) between the starts of two consecutive rows
+    int stride;
+    // Contiguous row-major buffer that holds all the values of the matrix
+    std::vector<T, Alloc> data;
+
+    /**
+     * @brief Evaluates an expression of the same shape into this matrix, one
+     *        fused pass per row. Safe when the expression refers to this
+     *        matrix, since every element only depends on the same position
+     *        of its operands
+     *
+     * @param e : the expression to be evaluated
+     */
+    template <typename E>
+    void evaluate(const E &e);
+
+    /**
+     * @brief Evaluates a transposed matrix with the cache-oblivious transpose
+     *        kernel instead of reading it column by column
+     *
+     * @param e : the transposed matrix to be evaluated
+     */
+    template <typename C, typename A>
+    void evaluate(const TransposeView<T, C, A> &e);
 public:
+    // Type of the elements, used by the expression templates
+    typedef T value_type;
+
+    /**
+     * @brief Computes the leading dimension for a row of c elements. Rows
+     *        longer than a cache line are padded so each one starts on a
+     *        cache line boundary
+     *
+     * @param c : number of columns
+     * @return the stride to use between consecutive rows
+     */
+    static int paddedStride(int c);
+
     /**
      * @brief Constructor to initialize the matrix with r rows and c columns
      *
@@ -119,6 +733,57 @@ public:
      */
     Matrix(int r, int c);
 
+    /**
+     * @brief Copy constructor, deep copies the elements of m
+     *
+     * @param m : the matrix to be copied
+     */
+    Matrix(const Matrix &m) = default;
+
+    /**
+     * @brief Move constructor, takes over the storage of m and leaves it as an
+     *        empty 0 x 0 matrix
+     *
+     * @param m : the matrix to be moved from
+     */
+    Matrix(Matrix &&m) noexcept;
+
+    /**
+     * @brief Copy assignment operator, deep copies the elements of m
+     *
+     * @param m : the matrix to be copied
+     * @return reference to the calling object
+     */
+    Matrix &operator=(const Matrix &m) = default;
+
+    /**
+     * @brief Move assignment operator, takes over the storage of m and leaves
+     *        it as an empty 0 x 0 matrix
+     *
+     * @param m : the matrix to be moved from
+     * @return reference to the calling object
+     */
+    Matrix &operator=(Matrix &&m) noexcept;
+
+    /**
+     * @brief Constructor that evaluates a Matrix expression (e.g. a + b - c * 3)
+     *        in a single pass, without building intermediate matrices
+     *
+     * @param e : the expression to be evaluated
+     */
+    template <typename E>
+    Matrix(const MatrixExpr<E> &e);
+
+    /**
+     * @brief Assigns the value of a Matrix expression in a single pass,
+     *        without building intermediate matrices
+     *
+     * @param e : the expression to be evaluated
+     * @return reference to the calling object
+     */
+    template <typename E>
+    Matrix &operator=(const MatrixExpr<E> &e);
+
     /**
      * @brief Returns the numbner of rows in the matrix
      *
@@ -134,280 +799,1702 @@ public:
     const int getCols() const;
 
     /**
-     * @brief Overloading non-const array (vector) index operator
+     * @brief Returns the distance (in elements) between the starts of two
+     *        consecutive rows in the underlying buffer
      *
-     * @param index : the row to be accessed
-     * @return the entire row vector
+     * @return the leading dimension of the matrix
      */
-    std::vector<T> &operator[](const int index);
+    int getStride() const;
 
     /**
-     * @brief Overloading the const array (vector) index operator
+     * @brief Returns a pointer to the first element of a row. No bounds
+     *        checking is performed
      *
      * @param index : the row to be accessed
-     * @return the entire row vector
+     * @return pointer to the first element of the row
      */
-    const std::vector<T> &operator[](const int index) const;
+    T *rowData(const int index);
 
     /**
-     * @brief Overloading the addition operator for Matrix
+     * @brief Returns a const pointer to the first element of a row. No bounds
+     *        checking is performed
      *
-     * @param m : the matrix to be added to the calling object
-     * @return the sum of the calling Matrix object and m
+     * @param index : the row to be accessed
+     * @return const pointer to the first element of the row
      */
-    const Matrix<T> operator+(const Matrix &m) const;
+    const T *rowData(const int index) const;
 
     /**
-     * @brief Overloading the subtraction operator for Matrix
+     * @brief Part of the expression interface. A matrix only supplies the
+     *        element at the position being written, so it is only a problem
+     *        when the target is a view of it at some other offset
      *
-     * @param m : the matrix to be subtracted from the calling object
-     * @return the difference between the calling Matrix object and m
+     * @param target : the storage being written
+     * @return true if the matrix overlaps target at shifted positions
      */
-    const Matrix<T> operator-(const Matrix &m) const;
+    bool mayAlias(const ExprTarget &target) const;
 
     /**
-     * @brief Overloading the multiplication operator for Matrix
+     * @brief Returns a non-owning view of the rows x cols block starting at
+     *        row r0, column c0. The view shares the matrix's storage, so
+     *        writes through it update the matrix, and it stays valid until the
+     *        matrix is resized, moved from or destroyed. The block is always
+     *        checked, whatever the Check policy. Views of temporaries are
+     *        deleted, since they would dangle as soon as the statement ends
      *
-     * @param m : the matrix to be multiplied to the calling object
-     * @return the product of the calling Matrix object and m
+     * @param r0 : first row of the block
+     * @param c0 : first column of the block
+     * @param rows : number of rows in the block
+     * @param cols : number of columns in the block
+     * @return a view of the block
      */
-    const Matrix<T> operator*(const Matrix &m) const;
+    MatrixView<T, Check> view(int r0, int c0, int rows, int cols) &;
+
+    MatrixView<const T, Check> view(int r0, int c0, int rows,
+                                    int cols) const &;
+
+    void view(int r0, int c0, int rows, int cols) && = delete;
 
     /**
-     * @brief Overloading the addition assignment operator for Matrix
+     * @brief Returns a lazy, non-owning transposed view of the matrix. Nothing
+     *        is copied: multiplying the view dispatches to a kernel that reads
+     *        the matrix transposed, and assigning it to a Matrix uses the
+     *        cache-oblivious transpose. Like view(), it is deleted for
+     *        temporaries; use transpose() to get an owning copy
      *
-     * @param m : the matrix to be added to the calling object
-     * @return reference to the calling object after m has been added to it
+     * @return a view of the transpose, valid as long as the matrix is
      */
-    Matrix<T> &operator+=(const Matrix &m);
+    TransposeView<T, Check, Alloc> t() const &;
+
+    void t() && = delete;
 
     /**
-     * @brief Overloading the subtraction assignment operator for Matrix
+     * @brief Returns the transpose of the matrix, computed by a cache-oblivious
+     *        blocked kernel
      *
-     * @param m : the matrix to be subtracted from the calling object
-     * @return reference to the calling object after m has been subtracted from
-     *         it
+     * @return a new matrix holding the transpose
      */
-    Matrix<T> &operator-=(const Matrix &m);
+    Matrix transpose() const;
 
     /**
-     * @brief Overloading the multiplication assignment operator for Matrix
+     * @brief Transposes the matrix in place. Square matrices are transposed
+     *        without any extra storage, other shapes go through a temporary
      *
-     * @param m : the matrix to be multiplied to the calling object
-     * @return reference to the calling object after m has been multiplied to it
+     * @return reference to the calling object after it has been transposed
      */
-    Matrix<T> &operator*=(const Matrix &m);
+    Matrix &transposeInPlace();
 
     /**
-     * @brief Overloading the equality check operator for Matrix
+     * @brief Returns the element at row i, column j. Both indices are always
+     *        checked, whatever the Check policy
      *
-     * @param m : the matrix to be compared to the calling object
-     * @return true if the matrices are equal, false otherwise
+     * @param i : row of the element
+     * @param j : column of the element
+     * @return reference to the element
      */
-    bool operator==(const Matrix &m) const;
+    T &at(const int i, const int j);
+
+    const T &at(const int i, const int j) const;
 
     /**
-     * @brief Overloading the not-equal check operator for Matrix
+     * @brief Returns the element at row i, column j. No bounds checking is
+     *        performed, whatever the Check policy
      *
-     * @param m : the matrix to be compared to the calling object
-     * @return true if the matrices not equal false otherwise
+     * @param i : row of the element
+     * @param j : column of the element
+     * @return reference to the element
      */
-    bool operator!=(const Matrix &m) const;
+    T &operator()(const int i, const int j);
+
+    const T &operator()(const int i, const int j) const;
 
     /**
-     * @brief Overloading the multiplication operator (with scalars) for Matrix
+     * @brief Overloading non-const array (vector) index operator. The row is
+     *        checked unless the Check policy disables it
      *
-     * @param m : the matrix to be multiplied with the scalar
-     * @param c : the scalar to be multiplied with the matrix
-     * @return the product of the matrix and the scalar
+     * @param index : the row to be accessed
+     * @return a view of the entire row
      */
-    template <typename L>
-    friend const Matrix<T> operator*(const Matrix<T> &m, T c);
+    MatrixRow<T> operator[](const int index);
 
     /**
-     * @brief Overloading the multiplication operator (with scalars) for Matrix
+     * @brief Overloading the const array (vector) index operator
      *
-     * @param c : the scalar to be multiplied with the matrix
-     * @param m : the matrix to be multiplied with the scalar
-     * @return the product of the matrix and the scalar
+     * @param index : the row to be accessed
+     * @return a read-only view of the entire row
      */
-    template <typename L>
-    friend const Matrix<T> operator*(T c, const Matrix<T> &m);
+    MatrixRow<const T> operator[](const int index) const;
 
     /**
-     * @brief Overloading the multiplication assignment operator (with scalars)
-     *        for Matrix
+     * @brief Overloading the multiplication operator for Matrix
      *
-     * @param m : the matrix to be multiplied with the scalar
-     * @param c : the scalar to be multiplied with the matrix
-     * @return the matrix m after the scalar has been multiplied to it
+     * @param m : the matrix to be multiplied to the calling object
+     * @return the product of the calling Matrix object and m
      */
-    template <typename L>
-    friend Matrix<T> &operator*=(Matrix<T> &m, T c);
+    Matrix operator*(const Matrix &m) const;
 
     /**
-     * @brief Overloading the stream extraction operator to print Matrix object
+     * @brief Multiplies with the textbook i-j-k loop instead of the blocked
+     *        kernel used by operator*. Meant as a reference for correctness
+     *        checks, not for production use
      *
-     * @param o : the output stream to print the output to
-     * @param m : the matrix to be printed
-     * @return reference to the output stream after the matrix has been printed
+     * @param m : the matrix to be multiplied to the calling object
+     * @return the product of the calling Matrix object and m
      */
-    template <typename L>
-    friend std::ostream &operator<<(std::ostream &o, const Matrix<T> &m);
-};
+    Matrix multiplyReference(const Matrix &m) const;
 
-template <typename T>
-Matrix<T>::Matrix(int r, int c) {
+    /**
+     * @brief Multiplies with the Strassen-Winograd algorithm, recursing until
+     *        blocks reach the crossover size and then using the blocked
+     *        kernel. Only square products take this path, anything else falls
+     *        back to operator*. Opt-in only: it trades some floating point
+     *        accuracy for O(n^2.81) work, so it is meant for large float and
+     *        double matrices
+     *
+     * @param m : the matrix to be multiplied to the calling object
+     * @param crossover : block size at or below which the blocked kernel is
+     *                    used
+     * @return the product of the calling Matrix object and m
+     */
+    Matrix multiplyStrassen(const Matrix &m,
+            int crossover = matrix_kernels::STRASSEN_CROSSOVER) const;
+
+    /**
+     * @brief Multiplies complex matrices with the 3M (Gauss) method: three
+     *        real products on the split real and imaginary parts instead of
+     *        four. Opt-in only: about 25% less work for large products, but
+     *        the imaginary parts lose some accuracy to cancellation. Real
+     *        element types fall back to operator*
+     *
+     * @param m : the matrix to be multiplied to the calling object
+     * @return the product of the calling Matrix object and m
+     */
+    Matrix multiply3M(const Matrix &m) const;
+
+    /**
+     * @brief Overloading the addition assignment operator for Matrix
+     *
+     * @param m : the matrix to be added to the calling object
+     * @return reference to the calling object after m has been added to it
+     */
+    Matrix &operator+=(const Matrix &m);
+
+    /**
+     * @brief Overloading the subtraction assignment operator for Matrix
+     *
+     * @param m : the matrix to be subtracted from the calling object
+     * @return reference to the calling object after m has been subtracted from
+     *         it
+     */
+    Matrix &operator-=(const Matrix &m);
+
+    /**
+     * @brief Overloading the addition assignment operator for Matrix
+     *        expressions, fused into a single pass over the calling object
+     *
+     * @param e : the expression to be added to the calling object
+     * @return reference to the calling object after e has been added to it
+     */
+    template <typename E>
+    Matrix &operator+=(const MatrixExpr<E> &e);
+
+    /**
+     * @brief Overloading the subtraction assignment operator for Matrix
+     *        expressions, fused into a single pass over the calling object
+     *
+     * @param e : the expression to be subtracted from the calling object
+     * @return reference to the calling object after e has been subtracted
+     *         from it
+     */
+    template <typename E>
+    Matrix &operator-=(const MatrixExpr<E> &e);
+
+    /**
+     * @brief Overloading the multiplication assignment operator for Matrix.
+     *        The product is computed into a per-thread scratch buffer that
+     *        is swapped in; the old storage is kept as the next call's
+     *        scratch when it has the product's size, so repeated *= of a
+     *        square matrix does not allocate
+     *
+     * @param m : the matrix to be multiplied to the calling object
+     * @return reference to the calling object after m has been multiplied to it
+     */
+    Matrix &operator*=(const Matrix &m);
+
+    /**
+     * @brief Overloading the equality check operator for Matrix. The other
+     *        matrix may use any access policy and allocator; taking it as is
+     *        (rather than converting it) keeps this overload an exact match,
+     *        ahead of the generic expression comparison
+     *
+     * @param m : the matrix to be compared to the calling object
+     * @return true if the matrices are equal, false otherwise
+     */
+    template <typename C, typename A>
+    bool operator==(const Matrix<T, C, A> &m) const;
+
+    /**
+     * @brief Overloading the not-equal check operator for Matrix
+     *
+     * @param m : the matrix to be compared to the calling object
+     * @return true if the matrices not equal false otherwise
+     */
+    template <typename C, typename A>
+    bool operator!=(const Matrix<T, C, A> &m) const;
+
+    /**
+     * @brief Overloading the multiplication assignment operator (with scalars)
+     *        for Matrix
+     *
+     * @param m : the matrix to be multiplied with the scalar
+     * @param c : the scalar to be multiplied with the matrix
+     * @return the matrix m after the scalar has been multiplied to it
+     */
+    template <typename L>
+    friend Matrix &operator*=(Matrix &m, T c);
+
+    /**
+     * @brief Overloading the stream extraction operator to print Matrix object
+     *
+     * @param o : the output stream to print the output to
+     * @param m : the matrix to be printed
+     * @return reference to the output stream after the matrix has been printed
+     */
+    template <typename L>
+    friend std::ostream &operator<<(std::ostream &o, const Matrix &m);
+};
+
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc>::Matrix(int r, int c) {
     if (r < 0 || c < 0) {
         throw InvalidDimension(r, c);
     }
     Matrix::row = r;
     Matrix::col = c;
-    // Resize the vector to fit r rows and c columns
-    data.resize((unsigned) r, std::vector<T>((unsigned) c));
+    Matrix::stride = paddedStride(c);
+    // Resize the buffer to fit r rows of stride elements each
+    data.resize((std::size_t) r * (std::size_t) stride, T());
 }
 
-template <typename T>
-const int Matrix<T>::getRows() const {
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc>::Matrix(Matrix<T, Check, Alloc> &&m) noexcept
+        : row(m.row), col(m.col), stride(m.stride), data(std::move(m.data)) {
+    m.row = 0;
+    m.col = 0;
+    m.stride = 0;
+    m.data.clear();
+}
+
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> &Matrix<T, Check, Alloc>::operator=(
+        Matrix<T, Check, Alloc> &&m) noexcept {
+    if (this != &m) {
+        this->row = m.row;
+        this->col = m.col;
+        this->stride = m.stride;
+        this->data = std::move(m.data);
+        m.row = 0;
+        m.col = 0;
+        m.stride = 0;
+        m.data.clear();
+    }
+    return *this;
+}
+
+template <typename T, typename Check, typename Alloc>
+template <typename E>
+Matrix<T, Check, Alloc>::Matrix(const MatrixExpr<E> &e)
+        : Matrix(e.self().getRows(), e.self().getCols()) {
+    evaluate(e.self());
+}
+
+template <typename T, typename Check, typename Alloc>
+template <typename E>
+void Matrix<T, Check, Alloc>::evaluate(const E &e) {
+    matrix_kernels::forRows(this->row, this->col, [&](int first, int last) {
+        for (int i = first; i < last; ++i) {
+            ExprEvaluator<E>::evalRow(e, i, this->rowData(i), this->col);
+        }
+    });
+}
+
+template <typename T, typename Check, typename Alloc>
+template <typename C, typename A>
+void Matrix<T, Check, Alloc>::evaluate(const TransposeView<T, C, A> &e) {
+    const Matrix<T, C, A> &m = e.t();
+    matrix_kernels::transpose(m.getRows(), m.getCols(), m.rowData(0),
+                              (std::size_t) m.getStride(), this->rowData(0),
+                              (std::size_t) this->stride);
+}
+
+template <typename T, typename Check, typename Alloc>
+template <typename E>
+Matrix<T, Check, Alloc> &Matrix<T, Check, Alloc>::operator=(
+        const MatrixExpr<E> &e) {
+    const E &expr = e.self();
+    if (expr.getRows() != this->row || expr.getCols() != this->col
+        || expr.mayAlias(ExprTarget::of(this->rowData(0), this->row,
+                                        this->col, this->stride))) {
+        // The result is built in fresh storage, either because the shape
+        // changes or because the expression reads this matrix out of place
+        // (e.g. a = a.t())
+        *this = Matrix<T, Check, Alloc>(expr);
+    } else {
+        evaluate(expr);
+    }
+    return *this;
+}
+
+template <typename T, typename Check, typename Alloc>
+int Matrix<T, Check, Alloc>::paddedStride(int c) {
+    const int line = 64;
+    if (c * sizeof(T) <= (std::size_t) line || line % sizeof(T) != 0) {
+        return c;
+    }
+    const int perLine = line / (int) sizeof(T);
+    return (c + perLine - 1) / perLine * perLine;
+}
+
+template <typename T, typename Check, typename Alloc>
+const int Matrix<T, Check, Alloc>::getRows() const {
     return this->row;
 }
 
-template <typename T>
-const int Matrix<T>::getCols() const {
+template <typename T, typename Check, typename Alloc>
+const int Matrix<T, Check, Alloc>::getCols() const {
     return this->col;
 }
 
-template <typename T>
-std::vector<T> &Matrix<T>::operator[](const int index) {
-    if (index < 0 || index >= this->row) {
+template <typename T, typename Check, typename Alloc>
+int Matrix<T, Check, Alloc>::getStride() const {
+    return this->stride;
+}
+
+template <typename T, typename Check, typename Alloc>
+T *Matrix<T, Check, Alloc>::rowData(const int index) {
+    return data.data() + (std::size_t) index * stride;
+}
+
+template <typename T, typename Check, typename Alloc>
+const T *Matrix<T, Check, Alloc>::rowData(const int index) const {
+    return data.data() + (std::size_t) index * stride;
+}
+
+template <typename T, typename Check, typename Alloc>
+bool Matrix<T, Check, Alloc>::mayAlias(const ExprTarget &target) const {
+    return target.overlapsShifted(ExprTarget::of(this->rowData(0), this->row,
+                                                 this->col, this->stride));
+}
+
+template <typename T, typename Check, typename Alloc>
+MatrixView<T, Check> Matrix<T, Check, Alloc>::view(int r0, int c0, int rows,
+                                            int cols) & {
+    MatrixView<T, Check>::checkBlock(r0, c0, rows, cols, this->row, this->col);
+    return MatrixView<T, Check>(this->rowData(r0) + c0, rows, cols,
+                                this->stride);
+}
+
+template <typename T, typename Check, typename Alloc>
+MatrixView<const T, Check> Matrix<T, Check, Alloc>::view(int r0, int c0,
+                                                         int rows,
+                                                         int cols) const & {
+    MatrixView<const T, Check>::checkBlock(r0, c0, rows, cols, this->row,
+                                           this->col);
+    return MatrixView<const T, Check>(this->rowData(r0) + c0, rows, cols,
+                                      this->stride);
+}
+
+template <typename T, typename Check, typename Alloc>
+TransposeView<T, Check, Alloc> Matrix<T, Check, Alloc>::t() const & {
+    return TransposeView<T, Check, Alloc>(*this);
+}
+
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> Matrix<T, Check, Alloc>::transpose() const {
+    Matrix<T, Check, Alloc> ret(this->col, this->row);
+    matrix_kernels::transpose(this->row, this->col, this->data.data(),
+                              (std::size_t) this->stride, ret.rowData(0),
+                              (std::size_t) ret.getStride());
+    return ret;
+}
+
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> &Matrix<T, Check, Alloc>::transposeInPlace() {
+    if (this->row == this->col) {
+        matrix_kernels::transposeInPlace(this->row, this->data.data(),
+                                         (std::size_t) this->stride);
+    } else {
+        *this = transpose();
+    }
+    return *this;
+}
+
+template <typename T, typename Check, typename Alloc>
+T &Matrix<T, Check, Alloc>::at(const int i, const int j) {
+    if (i < 0 || i >= this->row) {
+        throw IndexOutOfBounds(i);
+    }
+    if (j < 0 || j >= this->col) {
+        throw IndexOutOfBounds(j);
+    }
+    return rowData(i)[j];
+}
+
+template <typename T, typename Check, typename Alloc>
+const T &Matrix<T, Check, Alloc>::at(const int i, const int j) const {
+    if (i < 0 || i >= this->row) {
+        throw IndexOutOfBounds(i);
+    }
+    if (j < 0 || j >= this->col) {
+        throw IndexOutOfBounds(j);
+    }
+    return rowData(i)[j];
+}
+
+template <typename T, typename Check, typename Alloc>
+T &Matrix<T, Check, Alloc>::operator()(const int i, const int j) {
+    return rowData(i)[j];
+}
+
+template <typename T, typename Check, typename Alloc>
+const T &Matrix<T, Check, Alloc>::operator()(const int i, const int j) const {
+    return rowData(i)[j];
+}
+
+template <typename T, typename Check, typename Alloc>
+MatrixRow<T> Matrix<T, Check, Alloc>::operator[](const int index) {
+    if (Check::enabled && (index < 0 || index >= this->row)) {
         throw IndexOutOfBounds(index);
     }
-    return data[index];
+    return MatrixRow<T>(rowData(index), col);
 }
 
-template <typename T>
-const std::vector<T> &Matrix<T>::operator[](const int index) const {
-    if (index < 0 || index >= this->row) {
+template <typename T, typename Check, typename Alloc>
+MatrixRow<const T> Matrix<T, Check, Alloc>::operator[](const int index) const {
+    if (Check::enabled && (index < 0 || index >= this->row)) {
         throw IndexOutOfBounds(index);
     }
-    return data[index];
+    return MatrixRow<const T>(rowData(index), col);
 }
 
-template <typename T>
-const Matrix<T> Matrix<T>::operator+(const Matrix<T> &m) const {
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> &Matrix<T, Check, Alloc>::operator+=(
+        const Matrix<T, Check, Alloc> &m) {
     if (this->row != m.getRows() || this->col != m.getCols()) {
         throw IncompatibleMatrices('+', this->row, this->col, m.getRows(),
                                    m.getCols());
     }
-    Matrix<T> ret(this->row, this->col);
-    for(int i = 0; i < m.getRows(); ++i) {
-        for (int j = 0; j < m.getCols(); ++j) {
-            ret[i][j] = this->data[i][j] + m[i][j];
+    matrix_kernels::forRows(this->row, this->col, [&](int first, int last) {
+        for (int i = first; i < last; ++i) {
+            matrix_kernels::ElementwiseDispatch<T>::add(this->rowData(i),
+                                                        m.rowData(i),
+                                                        this->rowData(i),
+                                                        this->col);
         }
-    }
-    return ret;
+    });
+    return *this;
 }
 
-template <typename T>
-const Matrix<T> Matrix<T>::operator-(const Matrix<T> &m) const {
+template <typename T, typename Check, typename Alloc>
+template <typename E>
+Matrix<T, Check, Alloc> &Matrix<T, Check, Alloc>::operator+=(
+        const MatrixExpr<E> &e) {
+    *this = *this + e.self();
+    return *this;
+}
+
+template <typename T, typename Check, typename Alloc>
+template <typename E>
+Matrix<T, Check, Alloc> &Matrix<T, Check, Alloc>::operator-=(
+        const MatrixExpr<E> &e) {
+    *this = *this - e.self();
+    return *this;
+}
+
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> &Matrix<T, Check, Alloc>::operator-=(
+        const Matrix<T, Check, Alloc> &m) {
     if (this->row != m.getRows() || this->col != m.getCols()) {
         throw IncompatibleMatrices('-', this->row, this->col, m.getRows(),
                                    m.getCols());
     }
-    Matrix<T> ret(this->row, this->col);
-    for(int i = 0; i < m.getRows(); ++i) {
-        for (int j = 0; j < m.getCols(); ++j) {
-            ret[i][j] = this->data[i][j] - m[i][j];
+    matrix_kernels::forRows(this->row, this->col, [&](int first, int last) {
+        for (int i = first; i < last; ++i) {
+            matrix_kernels::ElementwiseDispatch<T>::sub(this->rowData(i),
+                                                        m.rowData(i),
+                                                        this->rowData(i),
+                                                        this->col);
         }
+    });
+    return *this;
+}
+
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> Matrix<T, Check, Alloc>::operator*(
+        const Matrix<T, Check, Alloc> &m) const {
+    if (this->col != m.getRows()) {
+        throw IncompatibleMatrices('*', this->row, this->col, m.getRows(),
+                                   m.getCols());
     }
+    Matrix<T, Check, Alloc> ret(this->row, m.getCols());
+    matrix_kernels::gemmParallel(this->row, m.getCols(), this->col,
+                                 this->data.data(), this->stride,
+                                 m.rowData(0), m.getStride(),
+                                 ret.rowData(0), ret.getStride());
     return ret;
 }
 
-template <typename T>
-Matrix<T> &Matrix<T>::operator+=(const Matrix<T> &m) {
-    *this = this->operator+(m);
-    return *this;
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> Matrix<T, Check, Alloc>::multiplyReference(
+        const Matrix<T, Check, Alloc> &m) const {
+    if (this->col != m.getRows()) {
+        throw IncompatibleMatrices('*', this->row, this->col, m.getRows(),
+                                   m.getCols());
+    }
+    Matrix<T, Check, Alloc> ret(this->row, m.getCols());
+    matrix_kernels::gemmReference(this->row, m.getCols(), this->col,
+                                  this->data.data(), this->stride,
+                                  m.rowData(0), m.getStride(),
+                                  ret.rowData(0), ret.getStride());
+    return ret;
 }
 
-template <typename T>
-Matrix<T> &Matrix<T>::operator-=(const Matrix<T> &m) {
-    *this = *this - m;
-    return *this;
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> Matrix<T, Check, Alloc>::multiplyStrassen(
+        const Matrix<T, Check, Alloc> &m, int crossover) const {
+    if (this->col != m.getRows()) {
+        throw IncompatibleMatrices('*', this->row, this->col, m.getRows(),
+                                   m.getCols());
+    }
+    if (this->row != this->col || m.getRows() != m.getCols()) {
+        return *this * m;
+    }
+    Matrix<T, Check, Alloc> ret(this->row, this->col);
+    matrix_kernels::strassen(this->row, this->data.data(),
+                             (std::size_t) this->stride, m.rowData(0),
+                             (std::size_t) m.getStride(), ret.rowData(0),
+                             (std::size_t) ret.getStride(),
+                             crossover < 1 ? 1 : crossover);
+    return ret;
 }
 
-template <typename T>
-const Matrix<T> Matrix<T>::operator*(const Matrix<T> &m) const {
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> Matrix<T, Check, Alloc>::multiply3M(
+        const Matrix<T, Check, Alloc> &m) const {
     if (this->col != m.getRows()) {
         throw IncompatibleMatrices('*', this->row, this->col, m.getRows(),
                                    m.getCols());
     }
-    Matrix<T> ret(this->row, m.getCols());
-    for(int i = 0; i < this->row; ++i) {
-        for(int j = 0; j < m.getCols(); ++j) {
-            for(int k = 0; k < this->col; ++k) {
-                ret[i][j] += this->data[i][k] * m[k][j];
-            }
+    Matrix<T, Check, Alloc> ret(this->row, m.getCols());
+    matrix_kernels::gemm3M(this->row, m.getCols(), this->col,
+                           this->data.data(), this->stride, m.rowData(0),
+                           m.getStride(), ret.rowData(0), ret.getStride());
+    return ret;
+}
+
+/**
+ * @brief Lazy transpose of a Matrix, returned by Matrix::t(). It holds a
+ *        reference to the matrix and works in any Matrix expression; in a
+ *        product it is never materialized, the multiplication kernel reads
+ *        the matrix transposed while packing its blocks
+ */
+template <typename T, typename Check, typename Alloc>
+class TransposeView : public MatrixExpr<TransposeView<T, Check, Alloc>> {
+private:
+    // The matrix being transposed
+    const Matrix<T, Check, Alloc> &source;
+public:
+    typedef T value_type;
+
+    // Row i of the view is column i of the matrix
+    struct Row {
+        const T *first;
+        std::size_t stride;
+
+        const T &operator[](const int j) const {
+            return first[j * stride];
         }
+    };
+
+    explicit TransposeView(const Matrix<T, Check, Alloc> &m) : source(m) {}
+
+    int getRows() const {
+        return source.getCols();
+    }
+
+    int getCols() const {
+        return source.getRows();
     }
+
+    /**
+     * @brief Transposes the view back
+     *
+     * @return the matrix being transposed
+     */
+    const Matrix<T, Check, Alloc> &t() const {
+        return source;
+    }
+
+    Row rowData(const int index) const {
+        Row ret = {source.rowData(0) + index, (std::size_t) source.getStride()};
+        return ret;
+    }
+
+    bool mayAlias(const ExprTarget &target) const {
+        return target.overlaps(ExprTarget::of(source.rowData(0),
+                                              source.getRows(),
+                                              source.getCols(),
+                                              source.getStride()));
+    }
+};
+
+/**
+ * @brief Overloading the multiplication operator for a transposed Matrix on
+ *        the left, A^T * B, without materializing the transpose
+ *
+ * @param l : the transposed matrix A^T
+ * @param r : the matrix to be multiplied to l
+ * @return the product of l and r
+ */
+template <typename T, typename CL, typename AL, typename CR, typename AR>
+Matrix<T, CL, AL> operator*(const TransposeView<T, CL, AL> &l,
+                        const Matrix<T, CR, AR> &r) {
+    const Matrix<T, CL, AL> &a = l.t();
+    if (a.getRows() != r.getRows()) {
+        throw IncompatibleMatrices('*', a.getCols(), a.getRows(), r.getRows(),
+                                   r.getCols());
+    }
+    Matrix<T, CL, AL> ret(a.getCols(), r.getCols());
+    matrix_kernels::gemmParallel(a.getCols(), r.getCols(), a.getRows(),
+                                 a.rowData(0), a.getStride(),
+                                 r.rowData(0), r.getStride(),
+                                 ret.rowData(0), ret.getStride(), true, false);
+    return ret;
+}
+
+/**
+ * @brief Overloading the multiplication operator for a transposed Matrix on
+ *        the right, A * B^T, without materializing the transpose
+ *
+ * @param l : the matrix A
+ * @param r : the transposed matrix B^T to be multiplied to l
+ * @return the product of l and r
+ */
+template <typename T, typename CL, typename AL, typename CR, typename AR>
+Matrix<T, CL, AL> operator*(const Matrix<T, CL, AL> &l,
+                        const TransposeView<T, CR, AR> &r) {
+    const Matrix<T, CR, AR> &b = r.t();
+    if (l.getCols() != b.getCols()) {
+        throw IncompatibleMatrices('*', l.getRows(), l.getCols(), b.getCols(),
+                                   b.getRows());
+    }
+    Matrix<T, CL, AL> ret(l.getRows(), b.getRows());
+    matrix_kernels::gemmParallel(l.getRows(), b.getRows(), l.getCols(),
+                                 l.rowData(0), l.getStride(),
+                                 b.rowData(0), b.getStride(),
+                                 ret.rowData(0), ret.getStride(), false, true);
+    return ret;
+}
+
+/**
+ * @brief Overloading the multiplication operator for two transposed matrices,
+ *        A^T * B^T, without materializing either transpose
+ *
+ * @param l : the transposed matrix A^T
+ * @param r : the transposed matrix B^T to be multiplied to l
+ * @return the product of l and r
+ */
+template <typename T, typename CL, typename AL, typename CR, typename AR>
+Matrix<T, CL, AL> operator*(const TransposeView<T, CL, AL> &l,
+                        const TransposeView<T, CR, AR> &r) {
+    const Matrix<T, CL, AL> &a = l.t();
+    const Matrix<T, CR, AR> &b = r.t();
+    if (a.getRows() != b.getCols()) {
+        throw IncompatibleMatrices('*', a.getCols(), a.getRows(), b.getCols(),
+                                   b.getRows());
+    }
+    Matrix<T, CL, AL> ret(a.getCols(), b.getRows());
+    matrix_kernels::gemmParallel(a.getCols(), b.getRows(), a.getRows(),
+                                 a.rowData(0), a.getStride(),
+                                 b.rowData(0), b.getStride(),
+                                 ret.rowData(0), ret.getStride(), true, true);
     return ret;
 }
 
+/**
+ * @brief Non-owning, strided view of a block of a Matrix, returned by
+ *        Matrix::view(). U is T for a writable view and const T for a
+ *        read-only one. A view works wherever a Matrix expression does, and
+ *        assigning to it (or to its elements) writes into the parent matrix.
+ *        Copying a view copies the reference, not the elements; assigning one
+ *        view to another copies the elements
+ */
+template <typename U, typename Check>
+class MatrixView : public MatrixExpr<MatrixView<U, Check>> {
+private:
+    // Element (0, 0) of the block in the parent's storage
+    U *first;
+    // Number of rows in the block
+    int row;
+    // Number of columns in the block
+    int col;
+    // Leading dimension of the parent
+    int stride;
+
+    /**
+     * @brief Evaluates an expression of the same shape into the block. If the
+     *        expression reads the block's memory out of place (e.g. an
+     *        overlapping view of the same parent), it is evaluated into a
+     *        temporary first
+     *
+     * @param e : the expression to be evaluated
+     */
+    template <typename E>
+    void assign(const E &e);
+public:
+    // Type of the elements, used by the expression templates
+    typedef typename std::remove_const<U>::type value_type;
+
+    MatrixView(U *p, int r, int c, int s)
+            : first(p), row(r), col(c), stride(s) {}
+
+    MatrixView(const MatrixView &v) = default;
+
+    // Allow a writable view to be passed where a read-only view is expected
+    template <typename V>
+    MatrixView(const MatrixView<V, Check> &v)
+            : first(v.rowData(0)), row(v.getRows()), col(v.getCols()),
+              stride(v.getStride()) {}
+
+    /**
+     * @brief Throws if the block does not fit in a rows x cols parent
+     */
+    static void checkBlock(int r0, int c0, int rows, int cols, int parentRows,
+                           int parentCols) {
+        if (rows < 0 || cols < 0) {
+            throw InvalidDimension(rows, cols);
+        }
+        if (r0 < 0 || r0 + rows > parentRows) {
+            throw IndexOutOfBounds(r0);
+        }
+        if (c0 < 0 || c0 + cols > parentCols) {
+            throw IndexOutOfBounds(c0);
+        }
+    }
+
+    int getRows() const {
+        return row;
+    }
+
+    int getCols() const {
+        return col;
+    }
+
+    int getStride() const {
+        return stride;
+    }
+
+    U *rowData(const int index) const {
+        return first + (std::size_t) index * stride;
+    }
+
+    bool mayAlias(const ExprTarget &target) const {
+        return target.overlapsShifted(ExprTarget::of(first, row, col, stride));
+    }
+
+    /**
+     * @brief Overloading the array index operator. The row is checked unless
+     *        the Check policy disables it
+     *
+     * @param index : the row of the block to be accessed
+     * @return a view of the entire row of the block
+     */
+    MatrixRow<U> operator[](const int index) const {
+        if (Check::enabled && (index < 0 || index >= row)) {
+            throw IndexOutOfBounds(index);
+        }
+        return MatrixRow<U>(rowData(index), col);
+    }
+
+    U &at(const int i, const int j) const {
+        if (i < 0 || i >= row) {
+            throw IndexOutOfBounds(i);
+        }
+        if (j < 0 || j >= col) {
+            throw IndexOutOfBounds(j);
+        }
+        return rowData(i)[j];
+    }
+
+    U &operator()(const int i, const int j) const {
+        return rowData(i)[j];
+    }
+
+    /**
+     * @brief Returns a view of a block of this view, in the view's own
+     *        coordinates
+     */
+    MatrixView view(int r0, int c0, int rows, int cols) const {
+        checkBlock(r0, c0, rows, cols, row, col);
+        return MatrixView(rowData(r0) + c0, rows, cols, stride);
+    }
+
+    /**
+     * @brief Copies the elements of v into the block
+     *
+     * @param v : a view of the same shape
+     * @return reference to the calling object
+     */
+    MatrixView &operator=(const MatrixView &v) {
+        assign(v);
+        return *this;
+    }
+
+    /**
+     * @brief Evaluates a Matrix expression into the block
+     *
+     * @param e : an expression of the same shape
+     * @return reference to the calling object
+     */
+    template <typename E>
+    MatrixView &operator=(const MatrixExpr<E> &e) {
+        assign(e.self());
+        return *this;
+    }
+
+    template <typename E>
+    MatrixView &operator+=(const MatrixExpr<E> &e) {
+        assign(*this + e.self());
+        return *this;
+    }
+
+    template <typename E>
+    MatrixView &operator-=(const MatrixExpr<E> &e) {
+        assign(*this - e.self());
+        return *this;
+    }
+
+    MatrixView &operator*=(const value_type &c) {
+        for (int i = 0; i < row; ++i) {
+            matrix_kernels::ElementwiseDispatch<value_type>::scale(
+                rowData(i), c, rowData(i), col);
+        }
+        return *this;
+    }
+};
+
+template <typename U, typename Check>
+template <typename E>
+void MatrixView<U, Check>::assign(const E &e) {
+    if (e.getRows() != row || e.getCols() != col) {
+        throw IncompatibleMatrices('=', row, col, e.getRows(), e.getCols());
+    }
+    if (e.mayAlias(ExprTarget::of(first, row, col, stride))) {
+        const Matrix<value_type> tmp(e);
+        for (int i = 0; i < row; ++i) {
+            std::copy(tmp.rowData(i), tmp.rowData(i) + col, rowData(i));
+        }
+        return;
+    }
+    matrix_kernels::forRows(row, col, [&](int first, int last) {
+        for (int i = first; i < last; ++i) {
+            ExprEvaluator<E>::evalRow(e, i, rowData(i), col);
+        }
+    });
+}
+
+/**
+ * @brief Multiplies two dense operands (Matrix or MatrixView) with the
+ *        blocked kernel, reading both in place
+ */
+template <typename T, typename Check, typename Alloc, typename A, typename B>
+Matrix<T, Check, Alloc> multiplyDense(const A &a, const B &b) {
+    if (a.getCols() != b.getRows()) {
+        throw IncompatibleMatrices('*', a.getRows(), a.getCols(), b.getRows(),
+                                   b.getCols());
+    }
+    Matrix<T, Check, Alloc> ret(a.getRows(), b.getCols());
+    matrix_kernels::gemmParallel(a.getRows(), b.getCols(), a.getCols(),
+                                 a.rowData(0), a.getStride(),
+                                 b.rowData(0), b.getStride(),
+                                 ret.rowData(0), ret.getStride());
+    return ret;
+}
+
+/**
+ * @brief Overloading the multiplication operator for views. The blocks are
+ *        multiplied in place, without copying them out of their parents
+ *
+ * @param l : the left operand
+ * @param r : the operand to be multiplied to l
+ * @return the product of l and r
+ */
+template <typename U, typename V, typename CL, typename CR>
+Matrix<typename std::remove_const<U>::type, CL> operator*(
+        const MatrixView<U, CL> &l, const MatrixView<V, CR> &r) {
+    typedef typename std::remove_const<U>::type T;
+    return multiplyDense<T, CL, AlignedAllocator<T>>(l, r);
+}
+
+template <typename U, typename T, typename CL, typename CR, typename A>
+Matrix<T, CL, A> operator*(const MatrixView<U, CL> &l,
+                           const Matrix<T, CR, A> &r) {
+    return multiplyDense<T, CL, A>(l, r);
+}
+
+template <typename T, typename V, typename CL, typename A, typename CR>
+Matrix<T, CL, A> operator*(const Matrix<T, CL, A> &l,
+                           const MatrixView<V, CR> &r) {
+    return multiplyDense<T, CL, A>(l, r);
+}
+
+/**
+ * @brief Matrix-vector product on raw arrays, y = A x, or y = A^T x when
+ *        transpose is set. Nothing is allocated, so it suits iterative
+ *        solvers that reuse their vectors. Large products are multithreaded
+ *
+ * @param a : the matrix A (a Matrix or a MatrixView)
+ * @param x : a.getCols() elements (a.getRows() when transposed)
+ * @param y : receives a.getRows() elements (a.getCols() when transposed);
+ *            must not overlap x
+ * @param transpose : whether to multiply by A^T
+ */
+template <typename A, typename T>
+void multiplyVector(const A &a, const T *x, T *y, bool transpose = false) {
+    const int length = transpose ? a.getCols() : a.getRows();
+    std::fill(y, y + length, T());
+    if (a.getRows() == 0 || a.getCols() == 0) {
+        return;
+    }
+    matrix_kernels::gemvParallel(a.getRows(), a.getCols(), a.rowData(0),
+                                 (std::size_t) a.getStride(), x, y,
+                                 transpose);
+}
+
+/**
+ * @brief Overloading the multiplication operator for a matrix and a column
+ *        vector, without building an N x 1 Matrix
+ *
+ * @param a : the matrix
+ * @param x : the vector to be multiplied to a, with a.getCols() elements
+ * @return the product a x, with a.getRows() elements
+ */
+template <typename T, typename Check, typename Alloc>
+std::vector<T> operator*(const Matrix<T, Check, Alloc> &a,
+                         const std::vector<T> &x) {
+    if ((std::size_t) a.getCols() != x.size()) {
+        throw IncompatibleMatrices('*', a.getRows(), a.getCols(),
+                                   (int) x.size(), 1);
+    }
+    std::vector<T> y((std::size_t) a.getRows());
+    multiplyVector(a, x.data(), y.data());
+    return y;
+}
+
+template <typename U, typename Check>
+std::vector<typename std::remove_const<U>::type> operator*(
+        const MatrixView<U, Check> &a,
+        const std::vector<typename std::remove_const<U>::type> &x) {
+    if ((std::size_t) a.getCols() != x.size()) {
+        throw IncompatibleMatrices('*', a.getRows(), a.getCols(),
+                                   (int) x.size(), 1);
+    }
+    std::vector<typename std::remove_const<U>::type> y(
+        (std::size_t) a.getRows());
+    multiplyVector(a, x.data(), y.data());
+    return y;
+}
+
+/**
+ * @brief Overloading the multiplication operator for a transposed matrix and
+ *        a column vector, A^T x, reading A in place
+ *
+ * @param a : the transposed matrix A^T
+ * @param x : the vector to be multiplied to a, with A.getRows() elements
+ * @return the product A^T x, with A.getCols() elements
+ */
+template <typename T, typename Check, typename Alloc>
+std::vector<T> operator*(const TransposeView<T, Check, Alloc> &a,
+                         const std::vector<T> &x) {
+    const Matrix<T, Check, Alloc> &m = a.t();
+    if ((std::size_t) m.getRows() != x.size()) {
+        throw IncompatibleMatrices('*', m.getCols(), m.getRows(),
+                                   (int) x.size(), 1);
+    }
+    std::vector<T> y((std::size_t) m.getCols());
+    multiplyVector(m, x.data(), y.data(), true);
+    return y;
+}
+
+namespace matrix_kernels {
+
+// Batch operands taken from arrays of matrices, read in place
+template <typename M>
+struct MatrixArrayBatch {
+    const M *a;
+    const M *b;
+    M *c;
+
+    const typename M::value_type *opA(int i) const {
+        return a[i].rowData(0);
+    }
+
+    const typename M::value_type *opB(int i) const {
+        return b[i].rowData(0);
+    }
+
+    typename M::value_type *opC(int i) const {
+        return c[i].rowData(0);
+    }
+};
+
+} // namespace matrix_kernels
+
+/**
+ * @brief Multiplies many independent pairs of matrices in one call,
+ *        c[i] = a[i] * b[i]. Shapes are checked once per batch rather than
+ *        once per product, the kernel is picked once (sizes up to 32 get
+ *        unrolled ones) and the batch is spread across the thread pool.
+ *        Outputs that already have the product's shape are written in place,
+ *        so reusing them across calls allocates nothing
+ *
+ * @param a : count left operands, all of a[0]'s shape
+ * @param b : count right operands, all of b[0]'s shape
+ * @param c : count results, distinct from the operands; resized as needed
+ * @param count : number of products
+ */
+template <typename T, typename Check, typename Alloc>
+void multiplyBatched(const Matrix<T, Check, Alloc> *a,
+                     const Matrix<T, Check, Alloc> *b,
+                     Matrix<T, Check, Alloc> *c, int count) {
+    if (count <= 0) {
+        return;
+    }
+    const int m = a[0].getRows();
+    const int k = a[0].getCols();
+    const int n = b[0].getCols();
+    for (int i = 0; i < count; ++i) {
+        if (a[i].getRows() != m || a[i].getCols() != k
+            || b[i].getRows() != k || b[i].getCols() != n) {
+            throw IncompatibleMatrices('*', a[i].getRows(), a[i].getCols(),
+                                       b[i].getRows(), b[i].getCols());
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        if (c[i].getRows() != m || c[i].getCols() != n) {
+            c[i] = Matrix<T, Check, Alloc>(m, n);
+        }
+    }
+    matrix_kernels::MatrixArrayBatch<Matrix<T, Check, Alloc>> batch =
+        {a, b, c};
+    matrix_kernels::gemmBatched<T>(count, m, n, k, batch,
+                                   (std::size_t) a[0].getStride(),
+                                   (std::size_t) b[0].getStride(),
+                                   (std::size_t) c[0].getStride());
+}
+
+/**
+ * @brief Multiplies a batch of matrices packed back to back in buffers:
+ *        product i reads the m x k matrix at a + i*m*k and the k x n matrix
+ *        at b + i*k*n, and writes the m x n result at c + i*m*n, all dense
+ *        and row-major. Nothing is allocated
+ *
+ * @param count : number of products
+ * @param m, n, k : shapes of the operands
+ * @param a, b : the packed left and right operands
+ * @param c : receives the packed results; must not overlap a or b
+ */
 template <typename T>
-Matrix<T> &Matrix<T>::operator*=(const Matrix<T> &m) {
-    *this = *this * m;
-    return *this;
+void multiplyBatched(int count, int m, int n, int k, const T *a, const T *b,
+                     T *c) {
+    if (m < 0 || n < 0 || k < 0) {
+        throw InvalidDimension(m < 0 ? m : k, n);
+    }
+    const std::size_t mk = (std::size_t) m * k;
+    const std::size_t kn = (std::size_t) k * n;
+    const std::size_t mn = (std::size_t) m * n;
+    matrix_kernels::StridedBatch<T> batch = {a, b, c, mk, kn, mn};
+    matrix_kernels::gemmBatched<T>(count, m, n, k, batch, (std::size_t) k,
+                                   (std::size_t) n, (std::size_t) n);
 }
 
+namespace matrix_kernels {
+
+// x^k by repeated squaring
 template <typename T>
-bool Matrix<T>::operator==(const Matrix<T> &m) const {
-    if (this->row != m.getRows() || this->col != m.getCols()) {
-        return false;
+T powScalar(T x, unsigned k) {
+    T result = T(1);
+    while (k != 0) {
+        if (k & 1) {
+            result *= x;
+        }
+        k >>= 1;
+        if (k != 0) {
+            x *= x;
+        }
     }
-    for (int i = 0; i < this->row; ++i) {
-        for (int j = 0; j < this->col; ++j) {
-            if (this->data[i][j] != m[i][j])
+    return result;
+}
+
+// True if every element off the diagonal of a square matrix is zero
+template <typename T>
+bool isDiagonal(int n, const T *a, std::size_t lda) {
+    for (int i = 0; i < n; ++i) {
+        const T *row = a + i * lda;
+        for (int j = 0; j < n; ++j) {
+            if (j != i && !(row[j] == T())) {
                 return false;
+            }
         }
     }
     return true;
 }
 
-template <typename T>
-bool Matrix<T>::operator!=(const Matrix<T> &m) const {
-    return !(*this == m);
+} // namespace matrix_kernels
+
+/**
+ * @brief Raises a square matrix to a power by repeated squaring, in at most
+ *        2 log2(k) products instead of k - 1. The products alternate between
+ *        three buffers allocated up front, so no step allocates. Diagonal
+ *        matrices are raised element by element
+ *
+ * @param m : the square matrix
+ * @param k : the exponent; m^0 is the identity
+ * @return m^k
+ */
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> pow(const Matrix<T, Check, Alloc> &m, unsigned k) {
+    const int n = m.getRows();
+    if (m.getCols() != n) {
+        throw IncompatibleMatrices('*', n, m.getCols(), n, m.getCols());
+    }
+    Matrix<T, Check, Alloc> result(n, n);
+    if (k == 0 || n == 0
+        || matrix_kernels::isDiagonal(n, m.rowData(0),
+                                      (std::size_t) m.getStride())) {
+        for (int i = 0; i < n; ++i) {
+            result.rowData(i)[i] = matrix_kernels::powScalar(m.rowData(i)[i],
+                                                             k);
+        }
+        return result;
+    }
+    Matrix<T, Check, Alloc> base = m;
+    Matrix<T, Check, Alloc> product(n, n);
+    const std::size_t ld = (std::size_t) result.getStride();
+    // product = x * y
+    auto multiply = [&](const Matrix<T, Check, Alloc> &x,
+                        const Matrix<T, Check, Alloc> &y) {
+        std::fill(product.rowData(0), product.rowData(0) + n * ld, T());
+        matrix_kernels::gemmParallel(n, n, n, x.rowData(0), ld, y.rowData(0),
+                                     ld, product.rowData(0), ld);
+    };
+    bool started = false;
+    while (true) {
+        if (k & 1) {
+            if (started) {
+                multiply(result, base);
+                std::swap(result, product);
+            } else {
+                result = base;
+                started = true;
+            }
+        }
+        k >>= 1;
+        if (k == 0) {
+            break;
+        }
+        multiply(base, base);
+        std::swap(base, product);
+    }
+    return result;
 }
 
-template <typename T>
-Matrix<T> const operator*(const Matrix<T> &m, T c) {
-    Matrix<T> ret(m.getRows(), m.getCols());
-    for(int i = 0; i < m.getRows(); ++i) {
-        for (int j = 0; j < m.getCols(); ++j) {
-            ret[i][j] = m[i][j] * c;
+namespace matrix_kernels {
+
+/**
+ * @brief Matrix-chain ordering: finds the parenthesization of the product
+ *        A_0 A_1 ... A_(n-1), A_i being dims[i] x dims[i + 1], that needs the
+ *        fewest multiply-adds, with the classic O(n^3) dynamic program
+ *
+ * @param dims : the n + 1 dimensions of the chain
+ * @param split : receives n x n entries; the best way to compute
+ *                A_i ... A_j (i < j) is (A_i ... A_s)(A_(s+1) ... A_j) with
+ *                s = split[i * n + j]
+ * @return the number of multiply-adds in the best order
+ */
+inline double chainOrder(const std::vector<int> &dims,
+                         std::vector<int> &split) {
+    const int n = (int) dims.size() - 1;
+    if (n <= 0) {
+        split.clear();
+        return 0;
+    }
+    // Products of thin chains overflow int, so costs are counted in doubles
+    std::vector<double> cost((std::size_t) n * n, 0.0);
+    split.assign((std::size_t) n * n, 0);
+    for (int length = 2; length <= n; ++length) {
+        for (int i = 0; i + length <= n; ++i) {
+            const int j = i + length - 1;
+            double best = -1;
+            for (int s = i; s < j; ++s) {
+                const double c = cost[i * n + s] + cost[(s + 1) * n + j]
+                                 + (double) dims[i] * dims[s + 1]
+                                   * dims[j + 1];
+                if (best < 0 || c < best) {
+                    best = c;
+                    split[i * n + j] = s;
+                }
+            }
+            cost[i * n + j] = best;
         }
     }
-    return ret;
+    return cost[n - 1];
 }
 
-template <typename T>
-Matrix<T> const operator*(T c, const Matrix<T> &m) {
-    return m * c;
+// Product of chain[i] ... chain[j] in the order chosen by chainOrder(). The
+// operands are used in place; only the inner products are materialized
+template <typename M>
+M chainProduct(const M *const *chain, const std::vector<int> &split, int n,
+               int i, int j) {
+    const int s = split[i * n + j];
+    M left(0, 0);
+    M right(0, 0);
+    const M &l = s == i ? *chain[i]
+                        : (left = chainProduct(chain, split, n, i, s));
+    const M &r = s + 1 == j ? *chain[j]
+                            : (right = chainProduct(chain, split, n, s + 1,
+                                                    j));
+    return l * r;
 }
 
-template <typename T>
-Matrix<T> &operator*=(Matrix<T> &m, T c) {
-    m = m * c;
+// Checks the shapes of a chain and multiplies it in the best order
+template <typename M>
+M multiplyChain(const M *const *chain, int count) {
+    if (count == 0) {
+        throw IncompatibleMatrices('*', 0, 0, 0, 0);
+    }
+    std::vector<int> dims(1, chain[0]->getRows());
+    for (int i = 0; i < count; ++i) {
+        if (chain[i]->getRows() != dims.back()) {
+            throw IncompatibleMatrices('*', chain[i - 1]->getRows(),
+                                       chain[i - 1]->getCols(),
+                                       chain[i]->getRows(),
+                                       chain[i]->getCols());
+        }
+        dims.push_back(chain[i]->getCols());
+    }
+    if (count == 1) {
+        return *chain[0];
+    }
+    std::vector<int> split;
+    chainOrder(dims, split);
+    return chainProduct(chain, split, count, 0, count - 1);
+}
+
+} // namespace matrix_kernels
+
+/**
+ * @brief Multiplies a chain of matrices in the order that needs the fewest
+ *        multiply-adds, rather than left to right. For thin operands this can
+ *        be orders of magnitude faster, e.g. (1000x10)(10x1000)(1000x10)
+ *        costs 200K multiply-adds right to left but 20M left to right
+ *
+ *     Matrix<double> p = multiplyChain(a, b, c, d);
+ *
+ * @param first, rest : the chain, at least one matrix
+ * @return the product of the chain
+ */
+template <typename T, typename Check, typename Alloc, typename... Rest>
+Matrix<T, Check, Alloc> multiplyChain(const Matrix<T, Check, Alloc> &first,
+                                      const Rest &... rest) {
+    const Matrix<T, Check, Alloc> *chain[] = {&first, &rest...};
+    return matrix_kernels::multiplyChain(chain, 1 + (int) sizeof...(rest));
+}
+
+/**
+ * @brief Multiplies a chain of matrices held in a vector in the order that
+ *        needs the fewest multiply-adds
+ *
+ * @param chain : the matrices, in order; must not be empty
+ * @return the product of the chain
+ */
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> multiplyChain(
+        const std::vector<Matrix<T, Check, Alloc>> &chain) {
+    std::vector<const Matrix<T, Check, Alloc> *> pointers;
+    for (const Matrix<T, Check, Alloc> &m : chain) {
+        pointers.push_back(&m);
+    }
+    return matrix_kernels::multiplyChain(pointers.data(),
+                                         (int) pointers.size());
+}
+
+/**
+ * @brief Multiplies a chain of matrices given as references in the order that
+ *        needs the fewest multiply-adds. The operands are not copied. A
+ *        braced list of plain matrices cannot deduce the element type, so
+ *        wrap them with std::cref (or use the variadic form, which does not
+ *        copy either)
+ *
+ *     Matrix<double> p = multiplyChain({std::cref(a), std::cref(b),
+ *                                       std::cref(c)});
+ *
+ * @param chain : the matrices, in order; must not be empty
+ * @return the product of the chain
+ */
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> multiplyChain(
+        std::initializer_list<std::reference_wrapper<
+            const Matrix<T, Check, Alloc>>> chain) {
+    std::vector<const Matrix<T, Check, Alloc> *> pointers;
+    for (const Matrix<T, Check, Alloc> &m : chain) {
+        pointers.push_back(&m);
+    }
+    return matrix_kernels::multiplyChain(pointers.data(),
+                                         (int) pointers.size());
+}
+
+/**
+ * @brief Overloading the equality check operator for Matrix expressions, so
+ *        views, transposes and unevaluated expressions compare element by
+ *        element with each other and with matrices
+ *
+ * @param l : the left operand
+ * @param r : the right operand
+ * @return true if the shapes and all the elements are equal, false otherwise
+ */
+template <typename L, typename R>
+bool operator==(const MatrixExpr<L> &l, const MatrixExpr<R> &r) {
+    const L &a = l.self();
+    const R &b = r.self();
+    if (a.getRows() != b.getRows() || a.getCols() != b.getCols()) {
+        return false;
+    }
+    // Every range stops as soon as any of them has found a difference
+    std::atomic<bool> equal(true);
+    matrix_kernels::forRows(a.getRows(), a.getCols(), [&](int first,
+                                                          int last) {
+        for (int i = first; i < last && equal.load(std::memory_order_relaxed);
+             ++i) {
+            if (!RowOps::equal(RowOps::constRow(a.rowData(i)),
+                               RowOps::constRow(b.rowData(i)), a.getCols()))
+                equal = false;
+        }
+    });
+    return equal;
+}
+
+template <typename L, typename R>
+bool operator!=(const MatrixExpr<L> &l, const MatrixExpr<R> &r) {
+    return !(l == r);
+}
+
+/**
+ * @brief Overloading the multiplication operator for a Matrix expression on
+ *        the left. The expression is evaluated once before multiplying
+ *
+ * @param l : the expression to be multiplied
+ * @param r : the matrix to be multiplied to l
+ * @return the product of l and r
+ */
+template <typename E, typename Check, typename Alloc>
+Matrix<typename E::value_type, Check, Alloc> operator*(
+        const MatrixExpr<E> &l,
+        const Matrix<typename E::value_type, Check, Alloc> &r) {
+    return Matrix<typename E::value_type, Check, Alloc>(l.self()) * r;
+}
+
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> &Matrix<T, Check, Alloc>::operator*=(
+        const Matrix<T, Check, Alloc> &m) {
+    if (this->col != m.getRows()) {
+        throw IncompatibleMatrices('*', this->row, this->col, m.getRows(),
+                                   m.getCols());
+    }
+    // The product is built in a per-thread scratch buffer (m may be this
+    // matrix) that is then swapped with this matrix's storage. The old
+    // storage becomes the scratch for the next call only if it has the
+    // product's size, so repeated *= of a square matrix never allocates,
+    // while a product of another shape does not leave a buffer behind
+    static thread_local std::vector<T, Alloc> scratch;
+    const int newStride = paddedStride(m.getCols());
+    const std::size_t size = (std::size_t) this->row * newStride;
+    scratch.assign(size, T());
+    matrix_kernels::gemmParallel(this->row, m.getCols(), this->col,
+                                 this->data.data(), this->stride,
+                                 m.rowData(0), m.getStride(),
+                                 scratch.data(), newStride);
+    this->data.swap(scratch);
+    if (scratch.size() != size) {
+        std::vector<T, Alloc>().swap(scratch);
+    }
+    this->col = m.getCols();
+    this->stride = newStride;
+    return *this;
+}
+
+template <typename T, typename Check, typename Alloc>
+template <typename C, typename A>
+bool Matrix<T, Check, Alloc>::operator==(const Matrix<T, C, A> &m) const {
+    if (this->row != m.getRows() || this->col != m.getCols()) {
+        return false;
+    }
+    // Every range stops as soon as any of them has found a difference
+    std::atomic<bool> equal(true);
+    matrix_kernels::forRows(this->row, this->col, [&](int first, int last) {
+        for (int i = first; i < last && equal.load(std::memory_order_relaxed);
+             ++i) {
+            if (!matrix_kernels::ElementwiseDispatch<T>::equal(
+                    this->rowData(i), m.rowData(i), this->col))
+                equal = false;
+        }
+    });
+    return equal;
+}
+
+template <typename T, typename Check, typename Alloc>
+template <typename C, typename A>
+bool Matrix<T, Check, Alloc>::operator!=(const Matrix<T, C, A> &m) const {
+    return !(*this == m);
+}
+
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> &operator*=(Matrix<T, Check, Alloc> &m, T c) {
+    matrix_kernels::forRows(m.getRows(), m.getCols(), [&](int first,
+                                                          int last) {
+        for (int i = first; i < last; ++i) {
+            matrix_kernels::ElementwiseDispatch<T>::scale(m.rowData(i), c,
+                                                          m.rowData(i),
+                                                          m.getCols());
+        }
+    });
     return m;
 }
 
-template <typename T>
-std::ostream &operator<<(std::ostream &o, const Matrix<T> &m) {
+/**
+ * @brief Overloading the addition operator for a temporary Matrix on the left.
+ *        The sum is computed in place and the temporary's storage is reused
+ *        for the result
+ *
+ * @param l : the temporary matrix, whose storage holds the result
+ * @param r : the matrix to be added to l
+ * @return the sum of l and r
+ */
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> operator+(Matrix<T, Check, Alloc> &&l,
+                                  const Matrix<T, Check, Alloc> &r) {
+    l += r;
+    return std::move(l);
+}
+
+/**
+ * @brief Overloading the addition operator for a temporary Matrix on the
+ *        right. The sum is computed in place and the temporary's storage is
+ *        reused for the result
+ *
+ * @param l : the matrix to be added to r
+ * @param r : the temporary matrix, whose storage holds the result
+ * @return the sum of l and r
+ */
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> operator+(const Matrix<T, Check, Alloc> &l,
+                                  Matrix<T, Check, Alloc> &&r) {
+    // Element-wise, so evaluating over r's own storage is safe
+    r = l + static_cast<const Matrix<T, Check, Alloc> &>(r);
+    return std::move(r);
+}
+
+/**
+ * @brief Overloading the addition operator for two temporary matrices. The
+ *        storage of l is reused for the result
+ *
+ * @param l : the temporary matrix, whose storage holds the result
+ * @param r : the temporary matrix to be added to l
+ * @return the sum of l and r
+ */
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> operator+(Matrix<T, Check, Alloc> &&l,
+                                  Matrix<T, Check, Alloc> &&r) {
+    l += r;
+    return std::move(l);
+}
+
+/**
+ * @brief Overloading the subtraction operator for a temporary Matrix on the
+ *        left. The difference is computed in place and the temporary's
+ *        storage is reused for the result
+ *
+ * @param l : the temporary matrix, whose storage holds the result
+ * @param r : the matrix to be subtracted from l
+ * @return the difference between l and r
+ */
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> operator-(Matrix<T, Check, Alloc> &&l,
+                                  const Matrix<T, Check, Alloc> &r) {
+    l -= r;
+    return std::move(l);
+}
+
+/**
+ * @brief Overloading the subtraction operator for a temporary Matrix on the
+ *        right. The difference is computed in place and the temporary's
+ *        storage is reused for the result
+ *
+ * @param l : the matrix r is subtracted from
+ * @param r : the temporary matrix, whose storage holds the result
+ * @return the difference between l and r
+ */
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> operator-(const Matrix<T, Check, Alloc> &l,
+                                  Matrix<T, Check, Alloc> &&r) {
+    // Element-wise, so evaluating over r's own storage is safe
+    r = l - static_cast<const Matrix<T, Check, Alloc> &>(r);
+    return std::move(r);
+}
+
+/**
+ * @brief Overloading the subtraction operator for two temporary matrices. The
+ *        storage of l is reused for the result
+ *
+ * @param l : the temporary matrix, whose storage holds the result
+ * @param r : the temporary matrix to be subtracted from l
+ * @return the difference between l and r
+ */
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> operator-(Matrix<T, Check, Alloc> &&l,
+                                  Matrix<T, Check, Alloc> &&r) {
+    l -= r;
+    return std::move(l);
+}
+
+/**
+ * @brief Overloading the multiplication operator (with scalars) for a
+ *        temporary Matrix. The temporary is scaled in place and its storage
+ *        is reused for the result
+ *
+ * @param m : the temporary matrix, whose storage holds the result
+ * @param c : the scalar to be multiplied with the matrix
+ * @return the product of the matrix and the scalar
+ */
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> operator*(
+        Matrix<T, Check, Alloc> &&m,
+        typename Matrix<T, Check, Alloc>::value_type c) {
+    m *= c;
+    return std::move(m);
+}
+
+/**
+ * @brief Overloading the multiplication operator (with scalars) for a
+ *        temporary Matrix. The temporary is scaled in place and its storage
+ *        is reused for the result
+ *
+ * @param c : the scalar to be multiplied with the matrix
+ * @param m : the temporary matrix, whose storage holds the result
+ * @return the product of the matrix and the scalar
+ */
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> operator*(
+        typename Matrix<T, Check, Alloc>::value_type c,
+        Matrix<T, Check, Alloc> &&m) {
+    m *= c;
+    return std::move(m);
+}
+
+namespace matrix_kernels {
+
+// Formatted text is handed to the stream in chunks of about this many bytes
+const std::size_t PRINT_CHUNK = 64 * 1024;
+
+// Prints rows through the stream itself, for element types TextFormat does
+// not know, for streams with a width, flags or a locale of their own and
+// while the C locale would change how TextFormat writes floating point
+template <typename E>
+void printThroughStream(std::ostream &o, const E &m) {
     for(int i = 0; i < m.getRows(); ++i) {
+        const auto in = m.rowData(i);
         for(int j = 0; j < m.getCols(); ++j) {
             /* Print the element at row i column j with a space
                (unless it's the last element) */
-            (j == m.getCols() - 1) ? o << m[i][j] : o << m[i][j] << " ";
+            (j == m.getCols() - 1) ? o << in[j] : o << in[j] << " ";
         }
-        o << std::endl;
+        o << '\n';
+    }
+}
+
+template <typename E>
+void printRows(std::ostream &o, const E &m, std::false_type) {
+    printThroughStream(o, m);
+}
+
+// Formats blocks of rows into memory and writes each block with one call.
+// Large matrices are formatted in parallel, a wave of blocks at a time so
+// only a few blocks are held in memory, and written in row order
+template <typename E>
+void printRows(std::ostream &o, const E &m, std::true_type) {
+    typedef TextFormat<typename E::value_type> Format;
+    if (!isDefaultTextFormat(o) || !Format::available()) {
+        printThroughStream(o, m);
+        return;
+    }
+    const int rows = m.getRows();
+    const int cols = m.getCols();
+    const int precision = (int) o.precision();
+    const std::size_t rowLength =
+        (Format::maxLength(precision) + 1) * (std::size_t) std::max(cols, 1);
+    const int block = (int) std::max<std::size_t>(1, PRINT_CHUNK / rowLength);
+
+    ThreadPool &pool = ThreadPool::instance();
+    const int threads = pool.getThreadCount();
+    if (threads <= 1 || (long) rows * cols < ParallelConfig::printCutoff()) {
+        std::string chunk;
+        for (int r = 0; r < rows; r += block) {
+            chunk.clear();
+            formatRows(m, r, std::min(rows, r + block), precision, chunk);
+            o.write(chunk.data(), (std::streamsize) chunk.size());
+        }
+        return;
+    }
+
+    std::vector<std::string> chunks((std::size_t) threads * 4);
+    const int perWave = (int) chunks.size();
+    for (int r = 0; r < rows; r += perWave * block) {
+        const int tasks = std::min(perWave, (rows - r + block - 1) / block);
+        pool.parallelFor(tasks, [&](int t) {
+            const int r0 = r + t * block;
+            chunks[t].clear();
+            formatRows(m, r0, std::min(rows, r0 + block), precision,
+                       chunks[t]);
+        });
+        for (int t = 0; t < tasks; ++t) {
+            o.write(chunks[t].data(), (std::streamsize) chunks[t].size());
+        }
+    }
+}
+
+} // namespace matrix_kernels
+
+/**
+ * @brief Overloading the stream extraction operator to print any Matrix
+ *        expression (a Matrix, a view, a transpose, a + b, ...), one row per
+ *        line with the elements separated by spaces. Numbers are formatted
+ *        into a buffer and written in large chunks, with a single flush at
+ *        the end; the text is the same as inserting each element with <<
+ *
+ * @param o : the output stream to print the output to
+ * @param e : the expression to be printed
+ * @return reference to the output stream after the matrix has been printed
+ */
+template <typename E>
+std::ostream &operator<<(std::ostream &o, const MatrixExpr<E> &e) {
+    typedef typename E::value_type T;
+    const E &m = e.self();
+    matrix_kernels::printRows(
+        o, m,
+        std::integral_constant<bool,
+                               matrix_kernels::TextFormat<T>::supported>());
+    if (m.getRows() > 0) {
+        o.flush();
     }
     return o;
 }
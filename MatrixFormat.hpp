@@ -0,0 +1,209 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      MatrixFormat.hpp
+//
+// Author:         Sahib Pandori and Haylee Monteiro
+// CS email:       sahib@cs.wisc.edu and haylee@cs.wisc.edu
+//
+// Description:    This file contains the buffered text formatter behind the
+//                 Matrix stream insertion operator
+///////////////////////////////////////////////////////////////////////////////
+#ifndef MATRIX_FORMAT_H
+#define MATRIX_FORMAT_H
+
+#include <clocale>
+#include <complex>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <ios>
+#include <locale>
+#include <string>
+#include <type_traits>
+
+namespace matrix_kernels {
+
+/**
+ * @brief Formats single elements straight into a character buffer, producing
+ *        exactly what `o << value` produces on a stream in its default state
+ *        (decimal, general floating point notation, classic locale) with the
+ *        given precision. Types without a specialization are not supported
+ *        (supported is false) and are printed through the stream instead, as
+ *        are all elements while available() is false
+ */
+template <typename T, typename Enable = void>
+struct TextFormat {
+    static const bool supported = false;
+};
+
+// Integer types that iostreams print as numbers (character types are not)
+template <typename T>
+struct IsPrintedAsInteger {
+    static const bool value = std::is_integral<T>::value
+                              && sizeof(T) > 1
+                              && !std::is_same<T, wchar_t>::value
+                              && !std::is_same<T, char16_t>::value
+                              && !std::is_same<T, char32_t>::value;
+};
+
+template <typename T>
+struct TextFormat<T, typename std::enable_if<
+        IsPrintedAsInteger<T>::value>::type> {
+    static const bool supported = true;
+
+    static bool available() {
+        return true;
+    }
+
+    // Longest output: 20 digits and a sign
+    static std::size_t maxLength(int) {
+        return 24;
+    }
+
+    static std::size_t write(char *out, const T &v, int) {
+        typedef typename std::make_unsigned<T>::type U;
+        char digits[24];
+        char *p = digits + sizeof(digits);
+        const bool negative = v < 0;
+        // Negate as unsigned so the most negative value does not overflow
+        U u = negative ? U(0) - U(v) : U(v);
+        do {
+            *--p = char('0' + u % 10);
+            u /= 10;
+        } while (u != 0);
+        if (negative) {
+            *--p = '-';
+        }
+        const std::size_t n = digits + sizeof(digits) - p;
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = p[i];
+        }
+        return n;
+    }
+};
+
+/**
+ * @brief True if the C library formats floating point numbers with a '.'.
+ *        printf follows the global C locale (LC_NUMERIC) while the stream
+ *        uses its own classic locale, so under a locale with a decimal comma
+ *        the two would disagree
+ */
+inline bool hasDecimalPoint() {
+    return std::strcmp(std::localeconv()->decimal_point, ".") == 0;
+}
+
+// float and double print like printf("%.*g"), which is what num_put uses
+template <typename T>
+struct TextFormat<T, typename std::enable_if<
+        std::is_same<T, float>::value || std::is_same<T, double>::value>::type> {
+    static const bool supported = true;
+
+    static bool available() {
+        return hasDecimalPoint();
+    }
+
+    // Shortest of %e and %f: the digits, a sign, a point and an exponent
+    static std::size_t maxLength(int precision) {
+        return (std::size_t) precision + 16;
+    }
+
+    static std::size_t write(char *out, const T &v, int precision) {
+        return (std::size_t) std::snprintf(out, maxLength(precision) + 1,
+                                           "%.*g", precision, (double) v);
+    }
+};
+
+template <>
+struct TextFormat<long double> {
+    static const bool supported = true;
+
+    static bool available() {
+        return hasDecimalPoint();
+    }
+
+    static std::size_t maxLength(int precision) {
+        return (std::size_t) precision + 16;
+    }
+
+    static std::size_t write(char *out, const long double &v, int precision) {
+        return (std::size_t) std::snprintf(out, maxLength(precision) + 1,
+                                           "%.*Lg", precision, v);
+    }
+};
+
+// Complex numbers print as (real,imag), each part formatted as above
+template <typename T>
+struct TextFormat<std::complex<T>, typename std::enable_if<
+        TextFormat<T>::supported>::type> {
+    static const bool supported = true;
+
+    static bool available() {
+        return TextFormat<T>::available();
+    }
+
+    static std::size_t maxLength(int precision) {
+        return 2 * TextFormat<T>::maxLength(precision) + 3;
+    }
+
+    static std::size_t write(char *out, const std::complex<T> &v,
+                             int precision) {
+        std::size_t n = 0;
+        out[n++] = '(';
+        n += TextFormat<T>::write(out + n, v.real(), precision);
+        out[n++] = ',';
+        n += TextFormat<T>::write(out + n, v.imag(), precision);
+        out[n++] = ')';
+        return n;
+    }
+};
+
+/**
+ * @brief True if a stream's formatting state is the default one that
+ *        TextFormat reproduces. Anything else (a width, hex, fixed, showpos,
+ *        a non-classic locale, ...) has to go through the stream
+ */
+inline bool isDefaultTextFormat(std::ios_base &o) {
+    const std::ios_base::fmtflags relevant =
+        std::ios_base::basefield | std::ios_base::floatfield
+        | std::ios_base::showpos | std::ios_base::showpoint
+        | std::ios_base::showbase | std::ios_base::uppercase;
+    return (o.flags() & relevant) == std::ios_base::dec && o.width() == 0
+           && o.precision() >= 0 && o.getloc() == std::locale::classic();
+}
+
+/**
+ * @brief Appends rows [r0, r1) of a matrix expression to out, elements
+ *        separated by spaces and each row ended by a newline
+ *
+ * @param m : the expression to be formatted
+ * @param r0, r1 : range of rows to format
+ * @param precision : floating point precision of the stream
+ * @param out : string the text is appended to
+ */
+template <typename E>
+void formatRows(const E &m, int r0, int r1, int precision, std::string &out) {
+    typedef typename E::value_type T;
+    typedef TextFormat<T> Format;
+    const int cols = m.getCols();
+    const std::size_t longest = Format::maxLength(precision) + 1;
+    std::size_t used = out.size();
+    for (int i = r0; i < r1; ++i) {
+        const auto in = m.rowData(i);
+        // Room for a whole row, so the inner loop never checks the size
+        out.resize(used + longest * (std::size_t) cols + 1);
+        char *p = &out[0] + used;
+        for (int j = 0; j < cols; ++j) {
+            p += Format::write(p, in[j], precision);
+            *p++ = ' ';
+        }
+        if (cols > 0) {
+            --p;
+        }
+        *p++ = '\n';
+        used = p - out.data();
+    }
+    out.resize(used);
+}
+
+} // namespace matrix_kernels
+
+#endif
@@ -0,0 +1,717 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      MatrixIO.hpp
+//
+// Author:         Sahib Pandori and Haylee Monteiro
+// CS email:       sahib@cs.wisc.edu and haylee@cs.wisc.edu
+//
+// Description:    This file contains the binary on-disk format for Matrix,
+//                 saveMatrix(), the memory-mapped loadMatrix() and the
+//                 out-of-core multiplyToFile() (POSIX)
+///////////////////////////////////////////////////////////////////////////////
+#ifndef MATRIX_IO_H
+#define MATRIX_IO_H
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Matrix.hpp"
+
+class MatrixFileError : public std::exception {
+private:
+    std::string message;
+public:
+    MatrixFileError(const std::string &path, const std::string &reason) {
+        this->message = "Matrix File Exception: " + path + ": " + reason
+                        + "\n";
+    }
+
+    virtual const char* what() const throw() {
+        return message.c_str();
+    }
+};
+
+/**
+ * @brief Header at the start of every matrix file. It is followed (at
+ *        dataOffset) by rows rows of stride elements each, in row-major order
+ *        and native byte order. Elements past cols in a row are padding
+ */
+struct MatrixFileHeader {
+    // Always MATRIX_FILE_MAGIC
+    char magic[8];
+    // MATRIX_FILE_BYTE_ORDER as written by the saving machine
+    std::uint32_t byteOrder;
+    // Format version, currently 1
+    std::uint32_t version;
+    // MatrixFileType<T>::code and sizeof(T) of the elements
+    std::uint32_t elementType;
+    std::uint32_t elementSize;
+    // Shape of the matrix and distance (in elements) between row starts
+    std::uint64_t rows;
+    std::uint64_t cols;
+    std::uint64_t stride;
+    // Byte offset of element (0, 0), a multiple of alignment
+    std::uint64_t dataOffset;
+    // Alignment of the data in the file, in bytes
+    std::uint32_t alignment;
+    std::uint32_t reserved;
+};
+
+static_assert(sizeof(MatrixFileHeader) == 64,
+              "MatrixFileHeader must stay 64 bytes");
+
+const char MATRIX_FILE_MAGIC[8] = {'M', 'A', 'T', 'R', 'I', 'X', '\0', '\1'};
+const std::uint32_t MATRIX_FILE_BYTE_ORDER = 0x01020304;
+const std::uint32_t MATRIX_FILE_VERSION = 1;
+// Data starts on a cache line, so mapped rows are as aligned as Matrix rows
+const std::uint32_t MATRIX_FILE_ALIGNMENT = 64;
+
+/**
+ * @brief Element type codes stored in the header. Types without a code cannot
+ *        be saved or loaded
+ */
+template <typename T>
+struct MatrixFileType;
+
+template <> struct MatrixFileType<int> { enum { code = 1 }; };
+template <> struct MatrixFileType<float> { enum { code = 2 }; };
+template <> struct MatrixFileType<double> { enum { code = 3 }; };
+template <> struct MatrixFileType<long long> { enum { code = 4 }; };
+template <> struct MatrixFileType<std::complex<int>> { enum { code = 5 }; };
+template <> struct MatrixFileType<std::complex<float>> { enum { code = 6 }; };
+template <> struct MatrixFileType<std::complex<double>> { enum { code = 7 }; };
+
+/**
+ * @brief How loadMatrix() maps a file
+ */
+enum MapMode {
+    // Pages are shared with the page cache and cannot be written
+    READ_ONLY,
+    // Pages are private: writes are allowed, copy the touched pages and never
+    // reach the file
+    COPY_ON_WRITE
+};
+
+/**
+ * @brief Returns the header of a file holding a rows x cols matrix of T, its
+ *        rows padded like Matrix rows and its data right after the header
+ */
+template <typename T>
+MatrixFileHeader matrixFileHeader(int rows, int cols) {
+    MatrixFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+    header.byteOrder = MATRIX_FILE_BYTE_ORDER;
+    header.version = MATRIX_FILE_VERSION;
+    header.elementType = MatrixFileType<T>::code;
+    header.elementSize = sizeof(T);
+    header.rows = rows;
+    header.cols = cols;
+    header.stride = Matrix<T>::paddedStride(cols);
+    header.dataOffset = sizeof(header);
+    header.alignment = MATRIX_FILE_ALIGNMENT;
+    return header;
+}
+
+/**
+ * @brief Writes a matrix (or any Matrix expression, e.g. a view) to a file in
+ *        the binary format described by MatrixFileHeader
+ *
+ * @param e : the matrix to be saved
+ * @param path : the file to be created or overwritten
+ */
+template <typename E>
+void saveMatrix(const MatrixExpr<E> &e, const std::string &path) {
+    typedef typename E::value_type T;
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only trivially copyable elements can be saved");
+    const E &m = e.self();
+    const MatrixFileHeader header =
+        matrixFileHeader<T>(m.getRows(), m.getCols());
+    const int stride = (int) header.stride;
+
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw MatrixFileError(path, "cannot be opened for writing");
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    // Each row is evaluated into a zero padded buffer, so views and
+    // expressions are written the same way as matrices
+    std::vector<T> row((std::size_t) stride, T());
+    for (int i = 0; i < m.getRows(); ++i) {
+        ExprEvaluator<E>::evalRow(m, i, row.data(), m.getCols());
+        file.write(reinterpret_cast<const char *>(row.data()),
+                   (std::streamsize) (row.size() * sizeof(T)));
+    }
+    if (!file.flush()) {
+        throw MatrixFileError(path, "write failed");
+    }
+}
+
+/**
+ * @brief Matrix backed by a memory-mapped file, returned by loadMatrix().
+ *        Opening it is O(1) whatever the size: pages are read from disk the
+ *        first time they are touched. It is a read-only Matrix expression, so
+ *        it can be used with the Matrix operators or copied into a Matrix.
+ *        view() and mutableView() give zero-copy views of it
+ */
+template <typename T>
+class MappedMatrix : public MatrixExpr<MappedMatrix<T>> {
+private:
+    // Start and length of the whole mapping (header included)
+    void *base;
+    std::size_t length;
+    // Element (0, 0)
+    T *first;
+    int row;
+    int col;
+    int stride;
+    MapMode mode;
+    // File the matrix was loaded from, for error messages
+    std::string source;
+
+    void release() {
+        if (base != nullptr) {
+            munmap(base, length);
+        }
+        base = nullptr;
+        length = 0;
+        first = nullptr;
+        row = col = stride = 0;
+    }
+public:
+    typedef T value_type;
+
+    /**
+     * @brief Maps a matrix file. See loadMatrix()
+     *
+     * @param path : the file to be mapped
+     * @param m : READ_ONLY or COPY_ON_WRITE
+     */
+    MappedMatrix(const std::string &path, MapMode m = READ_ONLY);
+
+    MappedMatrix(const MappedMatrix &) = delete;
+    MappedMatrix &operator=(const MappedMatrix &) = delete;
+
+    MappedMatrix(MappedMatrix &&m) noexcept
+            : base(m.base), length(m.length), first(m.first), row(m.row),
+              col(m.col), stride(m.stride), mode(m.mode),
+              source(std::move(m.source)) {
+        m.base = nullptr;
+        m.release();
+    }
+
+    MappedMatrix &operator=(MappedMatrix &&m) noexcept {
+        if (this != &m) {
+            release();
+            base = m.base;
+            length = m.length;
+            first = m.first;
+            row = m.row;
+            col = m.col;
+            stride = m.stride;
+            mode = m.mode;
+            source = std::move(m.source);
+            m.base = nullptr;
+            m.release();
+        }
+        return *this;
+    }
+
+    ~MappedMatrix() {
+        release();
+    }
+
+    int getRows() const {
+        return row;
+    }
+
+    int getCols() const {
+        return col;
+    }
+
+    int getStride() const {
+        return stride;
+    }
+
+    MapMode getMode() const {
+        return mode;
+    }
+
+    const T *rowData(const int index) const {
+        return first + (std::size_t) index * stride;
+    }
+
+    bool mayAlias(const ExprTarget &target) const {
+        return target.overlapsShifted(ExprTarget::of(first, row, col, stride));
+    }
+
+    /**
+     * @brief Returns a read-only view of the whole mapped matrix
+     *
+     * @return a view that can be used anywhere a MatrixView can
+     */
+    MatrixView<const T, CheckedAccess> view() const {
+        return MatrixView<const T, CheckedAccess>(first, row, col, stride);
+    }
+
+    /**
+     * @brief Returns a writable view of the whole mapped matrix. Only copy on
+     *        write mappings can be written; the file itself never changes
+     *
+     * @return a view that can be used anywhere a MatrixView can
+     */
+    MatrixView<T, CheckedAccess> mutableView() {
+        if (mode != COPY_ON_WRITE) {
+            throw MatrixFileError(source,
+                                  "read-only mapping cannot be written");
+        }
+        return MatrixView<T, CheckedAccess>(first, row, col, stride);
+    }
+};
+
+// Mapped matrices own their mapping, so expressions refer to them
+template <typename T>
+struct ExprOperand<MappedMatrix<T>> {
+    typedef const MappedMatrix<T> &type;
+};
+
+template <typename T>
+MappedMatrix<T>::MappedMatrix(const std::string &path, MapMode m)
+        : base(nullptr), length(0), first(nullptr), row(0), col(0), stride(0),
+          mode(m), source(path) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only trivially copyable elements can be loaded");
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw MatrixFileError(path, "cannot be opened for reading");
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (std::size_t) info.st_size
+                                 < sizeof(MatrixFileHeader)) {
+        close(fd);
+        throw MatrixFileError(path, "is not a matrix file");
+    }
+    length = (std::size_t) info.st_size;
+    const int prot = m == COPY_ON_WRITE ? PROT_READ | PROT_WRITE : PROT_READ;
+    const int flags = m == COPY_ON_WRITE ? MAP_PRIVATE : MAP_SHARED;
+    base = mmap(nullptr, length, prot, flags, fd, 0);
+    // The mapping keeps its own reference to the file
+    close(fd);
+    if (base == MAP_FAILED) {
+        base = nullptr;
+        throw MatrixFileError(path, "cannot be mapped");
+    }
+
+    MatrixFileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    const char *reason = nullptr;
+    if (std::memcmp(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic))
+        != 0) {
+        reason = "is not a matrix file";
+    } else if (header.byteOrder != MATRIX_FILE_BYTE_ORDER) {
+        reason = "was saved with a different byte order";
+    } else if (header.version != MATRIX_FILE_VERSION) {
+        reason = "has an unsupported format version";
+    } else if (header.elementType != (std::uint32_t) MatrixFileType<T>::code
+               || header.elementSize != sizeof(T)) {
+        reason = "holds a different element type";
+    } else if (header.rows > (std::uint64_t) std::numeric_limits<int>::max()
+               || header.stride
+                  > (std::uint64_t) std::numeric_limits<int>::max()
+               || header.cols > header.stride
+               || header.dataOffset % alignof(T) != 0
+               || header.dataOffset > length
+               || header.rows * header.stride
+                  > (length - header.dataOffset) / sizeof(T)) {
+        reason = "is truncated or corrupt";
+    }
+    if (reason != nullptr) {
+        release();
+        throw MatrixFileError(path, reason);
+    }
+    first = reinterpret_cast<T *>(static_cast<char *>(base)
+                                  + header.dataOffset);
+    row = (int) header.rows;
+    col = (int) header.cols;
+    stride = (int) header.stride;
+}
+
+/**
+ * @brief Opens a file written by saveMatrix() in O(1) time by mapping it into
+ *        memory. Nothing is read until elements are accessed
+ *
+ * @param path : the file to be loaded
+ * @param mode : READ_ONLY (the default) or COPY_ON_WRITE
+ * @return the mapped matrix; copy it into a Matrix<T> to own the data
+ */
+template <typename T>
+MappedMatrix<T> loadMatrix(const std::string &path, MapMode mode = READ_ONLY) {
+    return MappedMatrix<T>(path, mode);
+}
+
+/**
+ * @brief Default memory budget of multiplyToFile(), 256 MiB
+ */
+const std::size_t OUT_OF_CORE_BUDGET = std::size_t(256) << 20;
+
+namespace matrix_kernels {
+
+/**
+ * @brief Asks the kernel to start reading the pages of a range, so the faults
+ *        that follow find them in memory
+ */
+inline void adviseWillNeed(const void *p, std::size_t bytes) {
+    if (bytes == 0) {
+        return;
+    }
+    const std::uintptr_t page = (std::uintptr_t) sysconf(_SC_PAGESIZE);
+    const std::uintptr_t start = (std::uintptr_t) p & ~(page - 1);
+    madvise(reinterpret_cast<void *>(start),
+            (std::uintptr_t) p + bytes - start, MADV_WILLNEED);
+}
+
+/**
+ * @brief Copies rows [r0, r0 + rows) and columns [c0, c0 + cols) of an operand
+ *        into a packed tile. The reads of all the rows are started before
+ *        the first one is copied
+ */
+template <typename T>
+void loadTile(const T *src, std::size_t stride, int r0, int c0, int rows,
+              int cols, T *tile) {
+    for (int i = 0; i < rows; ++i) {
+        adviseWillNeed(src + (r0 + i) * stride + c0, cols * sizeof(T));
+    }
+    for (int i = 0; i < rows; ++i) {
+        const T *row = src + (r0 + i) * stride + c0;
+        std::copy(row, row + cols, tile + (std::size_t) i * cols);
+    }
+}
+
+/**
+ * @brief A matrix file being written through a shared mapping. Until
+ *        commit() succeeds the file is only temporary: the destructor unmaps
+ *        it and removes it, so a product that fails part way (by an
+ *        exception or a failed write) leaves nothing behind
+ */
+class PartialFile {
+private:
+    std::string path;
+    void *base;
+    std::size_t length;
+    bool committed;
+public:
+    /**
+     * @brief Creates (or truncates) path, writes the header and maps the
+     *        whole file, whose data reads as zero until written
+     *
+     * @param p : the file to be created
+     * @param header : the header written at the start of the file
+     * @param bytes : size of the whole file
+     */
+    PartialFile(const std::string &p, const MatrixFileHeader &header,
+                std::size_t bytes)
+            : path(p), base(nullptr), length(bytes), committed(false) {
+        const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw MatrixFileError(path, "cannot be opened for writing");
+        }
+        if (pwrite(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)
+            || ftruncate(fd, (off_t) length) != 0) {
+            close(fd);
+            unlink(path.c_str());
+            throw MatrixFileError(path, "write failed");
+        }
+        void *mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            unlink(path.c_str());
+            throw MatrixFileError(path, "cannot be mapped");
+        }
+        base = mapped;
+    }
+
+    PartialFile(const PartialFile &) = delete;
+    PartialFile &operator=(const PartialFile &) = delete;
+
+    ~PartialFile() {
+        if (base != nullptr) {
+            munmap(base, length);
+        }
+        if (!committed) {
+            unlink(path.c_str());
+        }
+    }
+
+    char *data() const {
+        return static_cast<char *>(base);
+    }
+
+    /**
+     * @brief Writes the file out, unmaps it and renames it to target
+     *
+     * @param target : the name the finished file is given
+     */
+    void commit(const std::string &target) {
+        const bool synced = msync(base, length, MS_SYNC) == 0;
+        munmap(base, length);
+        base = nullptr;
+        if (!synced || std::rename(path.c_str(), target.c_str()) != 0) {
+            throw MatrixFileError(target, "write failed");
+        }
+        committed = true;
+    }
+};
+
+/**
+ * @brief One background thread that runs posted jobs one at a time. It lives
+ *        for a whole multiplyToFile() call, so loading the next tiles does
+ *        not start a thread per step. An exception thrown by a job is
+ *        rethrown by wait(); the destructor lets a running job finish and
+ *        drops one that has not started
+ */
+class BackgroundWorker {
+private:
+    std::mutex lock;
+    std::condition_variable changed;
+    std::function<void()> job;
+    // Whether a job is posted and not finished
+    bool busy;
+    bool stopping;
+    std::exception_ptr error;
+    // Declared last, so it starts after the state it uses is ready
+    std::thread thread;
+
+    void loop() {
+        std::unique_lock<std::mutex> guard(lock);
+        for (;;) {
+            changed.wait(guard, [this] { return busy || stopping; });
+            if (stopping) {
+                return;
+            }
+            std::function<void()> current;
+            current.swap(job);
+            guard.unlock();
+            std::exception_ptr failure;
+            try {
+                current();
+            } catch (...) {
+                failure = std::current_exception();
+            }
+            guard.lock();
+            error = failure;
+            busy = false;
+            changed.notify_all();
+        }
+    }
+public:
+    BackgroundWorker()
+            : busy(false), stopping(false),
+              thread(&BackgroundWorker::loop, this) {}
+
+    BackgroundWorker(const BackgroundWorker &) = delete;
+    BackgroundWorker &operator=(const BackgroundWorker &) = delete;
+
+    ~BackgroundWorker() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        thread.join();
+    }
+
+    /**
+     * @brief Hands a job to the thread. The previous job must have been
+     *        waited for
+     */
+    void post(std::function<void()> j) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            job.swap(j);
+            busy = true;
+        }
+        changed.notify_all();
+    }
+
+    /**
+     * @brief Waits for the posted job to finish, rethrowing its exception
+     */
+    void wait() {
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [this] { return !busy; });
+        if (error) {
+            std::exception_ptr failure = error;
+            error = nullptr;
+            std::rethrow_exception(failure);
+        }
+    }
+};
+
+} // namespace matrix_kernels
+
+/**
+ * @brief Multiplies two matrices that need not fit in memory and writes the
+ *        product to a matrix file (see saveMatrix()) without ever holding it
+ *        whole. The operands are read in place, typically from
+ *        loadMatrix() mappings, and the product is computed one square tile
+ *        of C at a time: A and B tiles are copied into two sets of buffers,
+ *        the next pair being loaded on a background thread while the current
+ *        one is multiplied on the thread pool, and every finished C tile is
+ *        written through a mapping of the output and flushed. The product is
+ *        written to path + ".partial" and renamed to path once complete, so
+ *        path may name one of the operands' files. If anything fails the
+ *        partial file is removed and path is left as it was
+ *
+ * @param a : the left operand (a MappedMatrix, Matrix or MatrixView)
+ * @param b : the right operand
+ * @param path : the file to be created or replaced
+ * @param memoryBudget : bytes the tile buffers may use, 256 MiB by default;
+ *                       larger budgets mean larger tiles and fewer passes
+ *                       over the operands
+ */
+template <typename L, typename R>
+void multiplyToFile(const L &a, const R &b, const std::string &path,
+                    std::size_t memoryBudget = OUT_OF_CORE_BUDGET) {
+    typedef typename L::value_type T;
+    static_assert(std::is_same<T, typename R::value_type>::value,
+                  "operands must have the same element type");
+    if (a.getCols() != b.getRows()) {
+        throw IncompatibleMatrices('*', a.getRows(), a.getCols(),
+                                   b.getRows(), b.getCols());
+    }
+    const int m = a.getRows();
+    const int n = b.getCols();
+    const int k = a.getCols();
+
+    // The padding and the tiles not yet written read as zero
+    const MatrixFileHeader header = matrixFileHeader<T>(m, n);
+    const std::size_t length = sizeof(header)
+                               + (std::size_t) m * header.stride * sizeof(T);
+    matrix_kernels::PartialFile output(path + ".partial", header, length);
+    T *c = reinterpret_cast<T *>(output.data() + sizeof(header));
+    const std::size_t ldc = header.stride;
+
+    // Two A tiles, two B tiles and a C tile, all tile x tile
+    const std::size_t budget = memoryBudget / (5 * sizeof(T));
+    int tile = (int) std::sqrt((double) budget);
+    tile = tile >= 128 ? tile / 64 * 64 : std::max(tile, 16);
+    const int tm = std::min(tile, m);
+    const int tn = std::min(tile, n);
+    const int tk = std::min(tile, k);
+
+    struct Step {
+        int i0;
+        int j0;
+        int p0;
+    };
+    std::vector<Step> steps;
+    if (k > 0) {
+        for (int i0 = 0; i0 < m; i0 += tm) {
+            for (int j0 = 0; j0 < n; j0 += tn) {
+                for (int p0 = 0; p0 < k; p0 += tk) {
+                    steps.push_back(Step{i0, j0, p0});
+                }
+            }
+        }
+    }
+
+    typedef std::vector<T, AlignedAllocator<T>> Buffer;
+    Buffer at[2], bt[2];
+    Buffer ct((std::size_t) tm * tn);
+    for (int s = 0; s < 2 && !steps.empty(); ++s) {
+        at[s].resize((std::size_t) tm * tk);
+        bt[s].resize((std::size_t) tk * tn);
+    }
+    const T *aData = m > 0 && k > 0 ? a.rowData(0) : nullptr;
+    const T *bData = k > 0 && n > 0 ? b.rowData(0) : nullptr;
+    auto load = [&](std::size_t t) {
+        const Step &s = steps[t];
+        const int rows = std::min(tm, m - s.i0);
+        const int cols = std::min(tn, n - s.j0);
+        const int depth = std::min(tk, k - s.p0);
+        matrix_kernels::loadTile(aData, (std::size_t) a.getStride(), s.i0,
+                                 s.p0, rows, depth, at[t % 2].data());
+        matrix_kernels::loadTile(bData, (std::size_t) b.getStride(), s.p0,
+                                 s.j0, depth, cols, bt[t % 2].data());
+    };
+
+    if (!steps.empty()) {
+        load(0);
+    }
+    // Declared after the buffers, so it is joined before they go away
+    matrix_kernels::BackgroundWorker prefetch;
+    for (std::size_t t = 0; t < steps.size(); ++t) {
+        const bool more = t + 1 < steps.size();
+        if (more) {
+            prefetch.post([&load, t] { load(t + 1); });
+        }
+        const Step &s = steps[t];
+        const int rows = std::min(tm, m - s.i0);
+        const int cols = std::min(tn, n - s.j0);
+        const int depth = std::min(tk, k - s.p0);
+        if (s.p0 == 0) {
+            std::fill(ct.begin(), ct.end(), T());
+        }
+        matrix_kernels::gemmParallel(rows, cols, depth, at[t % 2].data(),
+                                     (std::size_t) depth, bt[t % 2].data(),
+                                     (std::size_t) cols, ct.data(),
+                                     (std::size_t) cols);
+        if (s.p0 + depth == k) {
+            T *out = c + s.i0 * ldc + s.j0;
+            for (int i = 0; i < rows; ++i) {
+                std::copy(ct.data() + (std::size_t) i * cols,
+                          ct.data() + (std::size_t) (i + 1) * cols,
+                          out + i * ldc);
+            }
+            // Start writing the tile back so dirty pages do not pile up
+            const std::uintptr_t page = (std::uintptr_t) sysconf(_SC_PAGESIZE);
+            const std::uintptr_t first = (std::uintptr_t) out & ~(page - 1);
+            msync(reinterpret_cast<void *>(first),
+                  (std::uintptr_t) (out + (rows - 1) * ldc + cols) - first,
+                  MS_ASYNC);
+        }
+        if (more) {
+            prefetch.wait();
+        }
+    }
+    output.commit(path);
+}
+
+/**
+ * @brief Multiplies two matrix files into a third one, out of core. See
+ *        multiplyToFile()
+ *
+ * @param aPath, bPath : files holding the operands, written by saveMatrix()
+ * @param cPath : the file to be created or replaced with the product
+ * @param memoryBudget : bytes the tile buffers may use
+ */
+template <typename T>
+void multiplyMatrixFiles(const std::string &aPath, const std::string &bPath,
+                         const std::string &cPath,
+                         std::size_t memoryBudget = OUT_OF_CORE_BUDGET) {
+    const MappedMatrix<T> a = loadMatrix<T>(aPath);
+    const MappedMatrix<T> b = loadMatrix<T>(bPath);
+    multiplyToFile(a, b, cPath, memoryBudget);
+}
+
+#endif
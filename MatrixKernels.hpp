@@ -0,0 +1,1472 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      MatrixKernels.hpp
+//
+// Author:         Sahib Pandori and Haylee Monteiro
+// CS email:       sahib@cs.wisc.edu and haylee@cs.wisc.edu
+//
+// Description:    This file contains the low level compute kernels used by
+//                 the Matrix operators. Every kernel works on raw row-major
+//                 buffers described by a pointer and a leading dimension
+//                 (stride), so they do not depend on the Matrix class itself
+///////////////////////////////////////////////////////////////////////////////
+#ifndef MATRIX_KERNELS_H
+#define MATRIX_KERNELS_H
+
+#include <algorithm>
+#include <atomic>
+#include <complex>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+// Pick the widest instruction set the compiler was told it may use. Define
+// MATRIX_NO_SIMD to force the portable scalar kernels
+#if !defined(MATRIX_NO_SIMD)
+#if defined(__AVX512F__)
+#define MATRIX_SIMD_AVX512
+#elif defined(__AVX2__)
+#define MATRIX_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#define MATRIX_SIMD_SSE2
+#endif
+#endif
+
+#if defined(MATRIX_SIMD_AVX512) || defined(MATRIX_SIMD_AVX2) \
+    || defined(MATRIX_SIMD_SSE2)
+#define MATRIX_HAVE_SIMD
+#include <immintrin.h>
+#endif
+
+namespace matrix_kernels {
+
+/**
+ * @brief Tile sizes for the blocked multiplication, derived from the size of
+ *        the element type
+ *
+ * MR x NR is the register tile updated by the micro-kernel, KC x NR slivers of
+ * B are sized to stay in L1, an MC x KC block of A stays in L2 and a KC x NC
+ * panel of B stays in L3
+ */
+template <typename T>
+struct GemmBlocking {
+    enum {
+        MR = 4,
+        NR = sizeof(T) >= 16 ? 4 : 64 / sizeof(T) > 16 ? 16 : 64 / sizeof(T),
+        KC = 256,
+        MC = (256 * 1024) / (256 * sizeof(T)) < 16
+             ? 16 : (256 * 1024) / (256 * sizeof(T)),
+        NC = (4 * 1024 * 1024) / (256 * sizeof(T)) < 64
+             ? 64 : (4 * 1024 * 1024) / (256 * sizeof(T))
+    };
+};
+
+/**
+ * @brief Products with fewer multiply-adds than this skip packing entirely
+ */
+const long GEMM_SMALL_CUTOFF = 32L * 32L * 32L;
+
+/**
+ * @brief Reference multiplication: the textbook i-j-k loop, C = A * B. Kept
+ *        as a correctness baseline for the faster kernels
+ *
+ * @param m, n, k : C is m x n, A is m x k and B is k x n
+ * @param a, lda : A and its leading dimension
+ * @param b, ldb : B and its leading dimension
+ * @param c, ldc : C and its leading dimension
+ */
+template <typename T>
+void gemmReference(int m, int n, int k, const T *a, std::size_t lda,
+                   const T *b, std::size_t ldb, T *c, std::size_t ldc) {
+    for (int i = 0; i < m; ++i) {
+        for (int j = 0; j < n; ++j) {
+            T sum = T();
+            for (int p = 0; p < k; ++p) {
+                sum += a[i * lda + p] * b[p * ldb + j];
+            }
+            c[i * ldc + j] = sum;
+        }
+    }
+}
+
+/**
+ * @brief Unpacked multiplication, C += op(A) * op(B), for products too small
+ *        to amortize packing. The inner loop runs along rows of B and C, or
+ *        along rows of both A and B (a dot product) when B is transposed
+ */
+template <typename T>
+void gemmSmall(int m, int n, int k, const T *a, std::size_t lda,
+               const T *b, std::size_t ldb, T *c, std::size_t ldc,
+               bool transA, bool transB) {
+    const std::size_t ia = transA ? 1 : lda;
+    const std::size_t pa = transA ? lda : 1;
+    for (int i = 0; i < m; ++i) {
+        T *out = c + i * ldc;
+        if (transB) {
+            for (int j = 0; j < n; ++j) {
+                const T *in = b + j * ldb;
+                T sum = T();
+                for (int p = 0; p < k; ++p) {
+                    sum += a[i * ia + p * pa] * in[p];
+                }
+                out[j] += sum;
+            }
+            continue;
+        }
+        for (int p = 0; p < k; ++p) {
+            const T aip = a[i * ia + p * pa];
+            const T *in = b + p * ldb;
+            for (int j = 0; j < n; ++j) {
+                out[j] += aip * in[j];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Copies an mc x kc block of A into MR-row panels, zero padding the
+ *        last panel. Within a panel element (r, p) lives at p * MR + r
+ */
+template <typename T>
+void packA(int mc, int kc, const T *a, std::size_t lda, T *buf) {
+    const int MR = GemmBlocking<T>::MR;
+    for (int i = 0; i < mc; i += MR) {
+        const int rows = std::min(MR, mc - i);
+        for (int p = 0; p < kc; ++p) {
+            for (int r = 0; r < rows; ++r) {
+                buf[p * MR + r] = a[(i + r) * lda + p];
+            }
+            for (int r = rows; r < MR; ++r) {
+                buf[p * MR + r] = T();
+            }
+        }
+        buf += kc * MR;
+    }
+}
+
+/**
+ * @brief Same as packA, for an mc x kc block of A^T read from A (a points at
+ *        element (p = 0, i = 0) of the kc x mc block of A). Each panel is
+ *        filled from contiguous runs of A's rows
+ */
+template <typename T>
+void packAT(int mc, int kc, const T *a, std::size_t lda, T *buf) {
+    const int MR = GemmBlocking<T>::MR;
+    for (int i = 0; i < mc; i += MR) {
+        const int rows = std::min(MR, mc - i);
+        for (int p = 0; p < kc; ++p) {
+            const T *in = a + p * lda + i;
+            for (int r = 0; r < rows; ++r) {
+                buf[p * MR + r] = in[r];
+            }
+            for (int r = rows; r < MR; ++r) {
+                buf[p * MR + r] = T();
+            }
+        }
+        buf += kc * MR;
+    }
+}
+
+/**
+ * @brief Copies a kc x nc block of B into NR-column panels, zero padding the
+ *        last panel. Within a panel element (p, c) lives at p * NR + c
+ */
+template <typename T>
+void packB(int kc, int nc, const T *b, std::size_t ldb, T *buf) {
+    const int NR = GemmBlocking<T>::NR;
+    for (int j = 0; j < nc; j += NR) {
+        const int cols = std::min(NR, nc - j);
+        for (int p = 0; p < kc; ++p) {
+            const T *in = b + p * ldb + j;
+            for (int c = 0; c < cols; ++c) {
+                buf[p * NR + c] = in[c];
+            }
+            for (int c = cols; c < NR; ++c) {
+                buf[p * NR + c] = T();
+            }
+        }
+        buf += kc * NR;
+    }
+}
+
+/**
+ * @brief Same as packB, for a kc x nc block of B^T read from B (b points at
+ *        element (j = 0, p = 0) of the nc x kc block of B)
+ */
+template <typename T>
+void packBT(int kc, int nc, const T *b, std::size_t ldb, T *buf) {
+    const int NR = GemmBlocking<T>::NR;
+    for (int j = 0; j < nc; j += NR) {
+        const int cols = std::min(NR, nc - j);
+        for (int c = 0; c < cols; ++c) {
+            const T *in = b + (j + c) * ldb;
+            for (int p = 0; p < kc; ++p) {
+                buf[p * NR + c] = in[p];
+            }
+        }
+        for (int c = cols; c < NR; ++c) {
+            for (int p = 0; p < kc; ++p) {
+                buf[p * NR + c] = T();
+            }
+        }
+        buf += kc * NR;
+    }
+}
+
+/**
+ * @brief Micro-kernel: multiplies a packed MR x kc panel of A by a packed
+ *        kc x NR panel of B in a register tile, then adds the valid mr x nr
+ *        corner of the tile to C
+ */
+template <typename T>
+void gemmMicro(int kc, const T *ap, const T *bp, T *c, std::size_t ldc,
+               int mr, int nr) {
+    const int MR = GemmBlocking<T>::MR;
+    const int NR = GemmBlocking<T>::NR;
+    T acc[MR][NR];
+    for (int r = 0; r < MR; ++r) {
+        for (int j = 0; j < NR; ++j) {
+            acc[r][j] = T();
+        }
+    }
+    for (int p = 0; p < kc; ++p) {
+        const T *a = ap + p * MR;
+        const T *b = bp + p * NR;
+        for (int r = 0; r < MR; ++r) {
+            const T ar = a[r];
+            for (int j = 0; j < NR; ++j) {
+                acc[r][j] += ar * b[j];
+            }
+        }
+    }
+    for (int r = 0; r < mr; ++r) {
+        T *out = c + r * ldc;
+        for (int j = 0; j < nr; ++j) {
+            out[j] += acc[r][j];
+        }
+    }
+}
+
+/**
+ * @brief Cache-blocked multiplication, C += op(A) * op(B), where op(X) is X
+ *        or its transpose. Blocks of A and B are packed into contiguous
+ *        panels sized for L1/L2/L3 (see GemmBlocking) and multiplied by the
+ *        register-tiled micro-kernel. Transposed operands are transposed
+ *        while packing, so they are never materialized
+ *
+ * @param m, n, k : C is m x n, op(A) is m x k and op(B) is k x n
+ * @param a, lda : A and its leading dimension
+ * @param b, ldb : B and its leading dimension
+ * @param c, ldc : C and its leading dimension
+ * @param transA, transB : whether A (k x m) and B (n x k) are transposed
+ */
+template <typename T>
+void gemm(int m, int n, int k, const T *a, std::size_t lda,
+          const T *b, std::size_t ldb, T *c, std::size_t ldc,
+          bool transA = false, bool transB = false) {
+    typedef GemmBlocking<T> B;
+    if (m == 0 || n == 0 || k == 0) {
+        return;
+    }
+    if ((long) m * n * k <= GEMM_SMALL_CUTOFF) {
+        gemmSmall(m, n, k, a, lda, b, ldb, c, ldc, transA, transB);
+        return;
+    }
+    // Only allocate as much packing space as this product can use
+    const int kcMax = std::min((int) B::KC, k);
+    const int mcMax = std::min((int) B::MC, (m + B::MR - 1) / B::MR * B::MR);
+    const int ncMax = std::min((int) B::NC, (n + B::NR - 1) / B::NR * B::NR);
+    // The packing buffers are kept per thread and only ever grow, so repeated
+    // products do not go back to the heap
+    static thread_local std::vector<T> aBuf;
+    static thread_local std::vector<T> bBuf;
+    if (aBuf.size() < (std::size_t) mcMax * kcMax) {
+        aBuf.resize((std::size_t) mcMax * kcMax);
+    }
+    if (bBuf.size() < (std::size_t) kcMax * ncMax) {
+        bBuf.resize((std::size_t) kcMax * ncMax);
+    }
+
+    for (int jc = 0; jc < n; jc += B::NC) {
+        const int nc = std::min((int) B::NC, n - jc);
+        for (int pc = 0; pc < k; pc += B::KC) {
+            const int kc = std::min((int) B::KC, k - pc);
+            if (transB) {
+                packBT(kc, nc, b + jc * ldb + pc, ldb, bBuf.data());
+            } else {
+                packB(kc, nc, b + pc * ldb + jc, ldb, bBuf.data());
+            }
+            for (int ic = 0; ic < m; ic += B::MC) {
+                const int mc = std::min((int) B::MC, m - ic);
+                if (transA) {
+                    packAT(mc, kc, a + pc * lda + ic, lda, aBuf.data());
+                } else {
+                    packA(mc, kc, a + ic * lda + pc, lda, aBuf.data());
+                }
+                for (int jr = 0; jr < nc; jr += B::NR) {
+                    const int nr = std::min((int) B::NR, nc - jr);
+                    for (int ir = 0; ir < mc; ir += B::MR) {
+                        const int mr = std::min((int) B::MR, mc - ir);
+                        gemmMicro(kc, aBuf.data() + ir * kc,
+                                  bBuf.data() + jr * kc,
+                                  c + (ic + ir) * ldc + jc + jr, ldc, mr, nr);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Element-wise kernels over n contiguous elements. This generic version
+ *        is plain scalar code and is used for any type without a vectorized
+ *        specialization (e.g. std::complex<int>)
+ */
+template <typename T>
+struct Elementwise {
+    // out = a + b
+    static void add(const T *a, const T *b, T *out, int n) {
+        for (int j = 0; j < n; ++j) {
+            out[j] = a[j] + b[j];
+        }
+    }
+
+    // out = a - b
+    static void sub(const T *a, const T *b, T *out, int n) {
+        for (int j = 0; j < n; ++j) {
+            out[j] = a[j] - b[j];
+        }
+    }
+
+    // out = a * c
+    static void scale(const T *a, T c, T *out, int n) {
+        for (int j = 0; j < n; ++j) {
+            out[j] = a[j] * c;
+        }
+    }
+
+    // true if a and b hold the same n values
+    static bool equal(const T *a, const T *b, int n) {
+        for (int j = 0; j < n; ++j) {
+            if (a[j] != b[j])
+                return false;
+        }
+        return true;
+    }
+
+    // out += a * c
+    static void axpy(const T *a, T c, T *out, int n) {
+        for (int j = 0; j < n; ++j) {
+            out[j] += a[j] * c;
+        }
+    }
+
+    // sum of a[j] * b[j]
+    static T dot(const T *a, const T *b, int n) {
+        T sum = T();
+        for (int j = 0; j < n; ++j) {
+            sum += a[j] * b[j];
+        }
+        return sum;
+    }
+};
+
+/**
+ * @brief Tunables for the parallel kernels
+ */
+struct ParallelConfig {
+    /**
+     * @brief Products with fewer multiply-adds than this run on the calling
+     *        thread only
+     */
+    static std::atomic<long> &gemmCutoff() {
+        static std::atomic<long> cutoff(128L * 128L * 128L);
+        return cutoff;
+    }
+
+    /**
+     * @brief Matrices with fewer elements than this are formatted for
+     *        printing on the calling thread only
+     */
+    static std::atomic<long> &printCutoff() {
+        static std::atomic<long> cutoff(256L * 1024L);
+        return cutoff;
+    }
+
+    /**
+     * @brief Element-wise operations and comparisons on matrices with fewer
+     *        elements than this run on the calling thread only
+     */
+    static std::atomic<long> &elementwiseCutoff() {
+        static std::atomic<long> cutoff(128L * 1024L);
+        return cutoff;
+    }
+};
+
+/**
+ * @brief Runs body(first, last) over the rows [0, rows) of an element-wise
+ *        operation. From ParallelConfig::elementwiseCutoff() elements on, the
+ *        rows are split into contiguous ranges (a few per thread, for
+ *        balance) run on the ThreadPool; below it body covers every row on
+ *        the calling thread. Each element is still computed by one thread
+ *        with the same kernel, so results do not depend on the split
+ *
+ * @param rows, cols : shape of the operation
+ * @param body : called with each range of rows
+ */
+template <typename F>
+void forRows(int rows, int cols, const F &body) {
+    ThreadPool &pool = ThreadPool::instance();
+    const int threads = pool.getThreadCount();
+    if (threads <= 1 || rows < 2
+        || (long) rows * cols < ParallelConfig::elementwiseCutoff()) {
+        body(0, rows);
+        return;
+    }
+    const int ranges = std::min(rows, 4 * threads);
+    const int size = (rows + ranges - 1) / ranges;
+    pool.parallelFor((rows + size - 1) / size, [&](int t) {
+        body(t * size, std::min(rows, (t + 1) * size));
+    });
+}
+
+/**
+ * @brief Multithreaded blocked multiplication, C += op(A) * op(B). C is split
+ *        into tiles that are scheduled on the shared ThreadPool, each running
+ *        the serial blocked kernel over the full depth k. Products below
+ *        ParallelConfig::gemmCutoff() run serially
+ *
+ * @param m, n, k : C is m x n, op(A) is m x k and op(B) is k x n
+ * @param a, lda : A and its leading dimension
+ * @param b, ldb : B and its leading dimension
+ * @param c, ldc : C and its leading dimension
+ * @param transA, transB : whether A (k x m) and B (n x k) are transposed
+ */
+template <typename T>
+void gemmParallel(int m, int n, int k, const T *a, std::size_t lda,
+                  const T *b, std::size_t ldb, T *c, std::size_t ldc,
+                  bool transA = false, bool transB = false) {
+    typedef GemmBlocking<T> B;
+    ThreadPool &pool = ThreadPool::instance();
+    const int threads = pool.getThreadCount();
+    if (threads <= 1 || (long) m * n * k < ParallelConfig::gemmCutoff()) {
+        gemm(m, n, k, a, lda, b, ldb, c, ldc, transA, transB);
+        return;
+    }
+    // Start from cache sized tiles and shrink them until there are a few
+    // tiles per thread to balance the load
+    int tileM = (int) B::MC;
+    int tileN = (int) B::NC;
+    while ((long) ((m + tileM - 1) / tileM) * ((n + tileN - 1) / tileN)
+           < 4L * threads) {
+        if (tileN >= 2 * tileM && tileN > 4 * B::NR) {
+            tileN /= 2;
+        } else if (tileM > 4 * B::MR) {
+            tileM /= 2;
+        } else {
+            break;
+        }
+    }
+    const int tilesM = (m + tileM - 1) / tileM;
+    const int tilesN = (n + tileN - 1) / tileN;
+    pool.parallelFor(tilesM * tilesN, [=](int t) {
+        const int i0 = (t / tilesN) * tileM;
+        const int j0 = (t % tilesN) * tileN;
+        gemm(std::min(tileM, m - i0), std::min(tileN, n - j0), k,
+             transA ? a + i0 : a + i0 * lda, lda,
+             transB ? b + j0 * ldb : b + j0, ldb, c + i0 * ldc + j0, ldc,
+             transA, transB);
+    });
+}
+
+/**
+ * @brief Per-thread scratch space for the planar complex products. It holds
+ *        one block of each operand, so its size is bounded by the blocking,
+ *        and it is kept so repeated products do not go back to the heap. A
+ *        thread that re-enters while its buffer is in use (by running
+ *        another product as a pool task while it waits) gets a buffer of its
+ *        own
+ */
+template <typename R>
+class PlanarScratch {
+private:
+    std::vector<R> local;
+    R *first;
+    // Whether this object holds the thread's shared buffer
+    bool owner;
+
+    static std::vector<R> &shared() {
+        static thread_local std::vector<R> buf;
+        return buf;
+    }
+
+    static bool &busy() {
+        static thread_local bool inUse = false;
+        return inUse;
+    }
+public:
+    explicit PlanarScratch(std::size_t n) : owner(!busy()) {
+        std::vector<R> &buf = owner ? shared() : local;
+        if (buf.size() < n) {
+            buf.resize(n);
+        }
+        first = buf.data();
+        if (owner) {
+            busy() = true;
+        }
+    }
+
+    PlanarScratch(const PlanarScratch &) = delete;
+    PlanarScratch &operator=(const PlanarScratch &) = delete;
+
+    ~PlanarScratch() {
+        if (owner) {
+            busy() = false;
+        }
+    }
+
+    R *get() const {
+        return first;
+    }
+};
+
+/**
+ * @brief Unpacked complex multiplication, C += op(A) * op(B), for products
+ *        too small to split. Products are expanded into real multiply-adds
+ *        instead of going through std::complex's operator*, which has to
+ *        recover infinities and NaNs and cannot be vectorized
+ */
+template <typename R>
+void gemmSmall(int m, int n, int k, const std::complex<R> *a,
+               std::size_t lda, const std::complex<R> *b, std::size_t ldb,
+               std::complex<R> *c, std::size_t ldc, bool transA,
+               bool transB) {
+    const std::size_t ia = transA ? 1 : lda;
+    const std::size_t pa = transA ? lda : 1;
+    for (int i = 0; i < m; ++i) {
+        std::complex<R> *out = c + i * ldc;
+        if (transB) {
+            for (int j = 0; j < n; ++j) {
+                const std::complex<R> *in = b + j * ldb;
+                R re = R(), im = R();
+                for (int p = 0; p < k; ++p) {
+                    const std::complex<R> x = a[i * ia + p * pa];
+                    re += x.real() * in[p].real() - x.imag() * in[p].imag();
+                    im += x.real() * in[p].imag() + x.imag() * in[p].real();
+                }
+                out[j] = std::complex<R>(out[j].real() + re,
+                                         out[j].imag() + im);
+            }
+            continue;
+        }
+        for (int p = 0; p < k; ++p) {
+            const std::complex<R> x = a[i * ia + p * pa];
+            const std::complex<R> *in = b + p * ldb;
+            for (int j = 0; j < n; ++j) {
+                const std::complex<R> y = in[j];
+                out[j] = std::complex<R>(
+                    out[j].real() + x.real() * y.real() - x.imag() * y.imag(),
+                    out[j].imag() + x.real() * y.imag() + x.imag() * y.real());
+            }
+        }
+    }
+}
+
+// Real product used on the planar blocks: gemm or gemmParallel
+template <typename R>
+using RealProduct = void (*)(int, int, int, const R *, std::size_t,
+                             const R *, std::size_t, R *, std::size_t, bool,
+                             bool);
+
+/**
+ * @brief One block of the 4M form of gemmComplex, C += A * B for an
+ *        mc x kc block of A and a kc x nc block of B, both read through the
+ *        strides ia/pa and pb/jb. The planar copy of B is only refreshed when
+ *        newB is set, since it is shared by every row block of C
+ *
+ * @param scratch : room for 4 * mc * kc + 2 * kc * nc + 2 * mc * nc reals.
+ *                  B's copy comes first, so it stays in place while later
+ *                  row blocks reuse it
+ */
+template <typename R>
+void gemm4MBlock(int mc, int nc, int kc, const std::complex<R> *a,
+                 std::size_t ia, std::size_t pa, const std::complex<R> *b,
+                 std::size_t pb, std::size_t jb, std::complex<R> *c,
+                 std::size_t ldc, bool newB, R *scratch,
+                 RealProduct<R> product) {
+    const int k2 = 2 * kc;
+    R *b2 = scratch;
+    R *a1 = b2 + (std::size_t) k2 * nc;
+    R *a2 = a1 + (std::size_t) mc * k2;
+    R *re = a2 + (std::size_t) mc * k2;
+    R *im = re + (std::size_t) mc * nc;
+    if (newB) {
+        for (int p = 0; p < kc; ++p) {
+            for (int j = 0; j < nc; ++j) {
+                const std::complex<R> y = b[p * pb + j * jb];
+                b2[p * nc + j] = y.real();
+                b2[(kc + p) * nc + j] = y.imag();
+            }
+        }
+    }
+    for (int i = 0; i < mc; ++i) {
+        R *r1 = a1 + i * k2;
+        R *r2 = a2 + i * k2;
+        for (int p = 0; p < kc; ++p) {
+            const std::complex<R> x = a[i * ia + p * pa];
+            r1[p] = x.real();
+            r1[kc + p] = -x.imag();
+            r2[p] = x.imag();
+            r2[kc + p] = x.real();
+        }
+    }
+    std::fill(re, re + 2 * (std::size_t) mc * nc, R());
+    product(mc, nc, k2, a1, k2, b2, nc, re, nc, false, false);
+    product(mc, nc, k2, a2, k2, b2, nc, im, nc, false, false);
+    for (int i = 0; i < mc; ++i) {
+        std::complex<R> *out = c + i * ldc;
+        for (int j = 0; j < nc; ++j) {
+            out[j] = std::complex<R>(out[j].real() + re[i * nc + j],
+                                     out[j].imag() + im[i * nc + j]);
+        }
+    }
+}
+
+/**
+ * @brief One block of the 3M form of gemmComplex, see gemm4MBlock
+ *
+ * @param scratch : room for 3 * (mc * kc + kc * nc + mc * nc) reals
+ */
+template <typename R>
+void gemm3MBlock(int mc, int nc, int kc, const std::complex<R> *a,
+                 std::size_t ia, std::size_t pa, const std::complex<R> *b,
+                 std::size_t pb, std::size_t jb, std::complex<R> *c,
+                 std::size_t ldc, bool newB, R *scratch,
+                 RealProduct<R> product) {
+    const std::size_t kn = (std::size_t) kc * nc;
+    const std::size_t mk = (std::size_t) mc * kc;
+    const std::size_t mn = (std::size_t) mc * nc;
+    R *br = scratch;
+    R *bi = br + kn;
+    R *bs = bi + kn;
+    R *ar = bs + kn;
+    R *ai = ar + mk;
+    R *as = ai + mk;
+    R *p1 = as + mk;
+    R *p2 = p1 + mn;
+    R *p3 = p2 + mn;
+    if (newB) {
+        for (int p = 0; p < kc; ++p) {
+            for (int j = 0; j < nc; ++j) {
+                const std::complex<R> y = b[p * pb + j * jb];
+                br[p * nc + j] = y.real();
+                bi[p * nc + j] = y.imag();
+                bs[p * nc + j] = y.real() + y.imag();
+            }
+        }
+    }
+    for (int i = 0; i < mc; ++i) {
+        for (int p = 0; p < kc; ++p) {
+            const std::complex<R> x = a[i * ia + p * pa];
+            ar[i * kc + p] = x.real();
+            ai[i * kc + p] = x.imag();
+            as[i * kc + p] = x.real() + x.imag();
+        }
+    }
+    std::fill(p1, p1 + 3 * mn, R());
+    product(mc, nc, kc, ar, kc, br, nc, p1, nc, false, false);
+    product(mc, nc, kc, ai, kc, bi, nc, p2, nc, false, false);
+    product(mc, nc, kc, as, kc, bs, nc, p3, nc, false, false);
+    for (int i = 0; i < mc; ++i) {
+        std::complex<R> *out = c + i * ldc;
+        for (int j = 0; j < nc; ++j) {
+            const std::size_t e = (std::size_t) i * nc + j;
+            out[j] = std::complex<R>(out[j].real() + (p1[e] - p2[e]),
+                                     out[j].imag() + (p3[e] - p1[e] - p2[e]));
+        }
+    }
+}
+
+/**
+ * @brief Complex multiplication, C += op(A) * op(B), on split (planar) real
+ *        and imaginary parts, so all the work is done by the real blocked
+ *        kernel, one block of A and B at a time. The default 4M form stacks
+ *        the parts along the inner dimension and runs two real products of
+ *        twice the block depth:
+ *            Re C += [Re A | -Im A] * [Re B ; Im B]
+ *            Im C += [Im A |  Re A] * [Re B ; Im B]
+ *        The 3M (Gauss) form runs three real products of the block depth,
+ *        25% fewer multiplications at the cost of some accuracy in Im C:
+ *            P1 = Re A Re B, P2 = Im A Im B, P3 = (Re A + Im A)(Re B + Im B)
+ *            Re C += P1 - P2, Im C += P3 - P1 - P2
+ *
+ * @param m, n, k : C is m x n, op(A) is m x k and op(B) is k x n
+ * @param a, lda : A and its leading dimension
+ * @param b, ldb : B and its leading dimension
+ * @param c, ldc : C and its leading dimension
+ * @param transA, transB : whether A (k x m) and B (n x k) are transposed
+ * @param threeM : use the 3M form
+ * @param parallel : run the real products on the ThreadPool
+ */
+template <typename R>
+void gemmComplex(int m, int n, int k, const std::complex<R> *a,
+                 std::size_t lda, const std::complex<R> *b, std::size_t ldb,
+                 std::complex<R> *c, std::size_t ldc, bool transA,
+                 bool transB, bool threeM, bool parallel) {
+    if (m == 0 || n == 0 || k == 0) {
+        return;
+    }
+    if ((long) m * n * k <= GEMM_SMALL_CUTOFF) {
+        gemmSmall(m, n, k, a, lda, b, ldb, c, ldc, transA, transB);
+        return;
+    }
+    typedef GemmBlocking<R> B;
+    // Element (i, p) of op(A) and (p, j) of op(B)
+    const std::size_t ia = transA ? 1 : lda;
+    const std::size_t pa = transA ? lda : 1;
+    const std::size_t pb = transB ? 1 : ldb;
+    const std::size_t jb = transB ? ldb : 1;
+    RealProduct<R> product = parallel ? &gemmParallel<R> : &gemm<R>;
+
+    // The parts are split one block at a time, so the scratch space is set
+    // by the blocking and not by the size of the product. Column blocks are
+    // half as wide as the real kernel's, since B is held twice or three times
+    const int NCC = (int) B::NC / 2;
+    const std::size_t mkMax = (std::size_t) std::min((int) B::MC, m)
+                              * std::min((int) B::KC, k);
+    const std::size_t knMax = (std::size_t) std::min((int) B::KC, k)
+                              * std::min(NCC, n);
+    const std::size_t mnMax = (std::size_t) std::min((int) B::MC, m)
+                              * std::min(NCC, n);
+    PlanarScratch<R> scratch(threeM ? 3 * (mkMax + knMax + mnMax)
+                                    : 4 * mkMax + 2 * knMax + 2 * mnMax);
+
+    for (int jc = 0; jc < n; jc += NCC) {
+        const int nc = std::min(NCC, n - jc);
+        for (int pc = 0; pc < k; pc += B::KC) {
+            const int kc = std::min((int) B::KC, k - pc);
+            const std::complex<R> *bBlock = b + pc * pb + jc * jb;
+            for (int ic = 0; ic < m; ic += B::MC) {
+                const int mc = std::min((int) B::MC, m - ic);
+                const std::complex<R> *aBlock = a + ic * ia + pc * pa;
+                std::complex<R> *cBlock = c + ic * ldc + jc;
+                if (threeM) {
+                    gemm3MBlock(mc, nc, kc, aBlock, ia, pa, bBlock, pb, jb,
+                                cBlock, ldc, ic == 0, scratch.get(), product);
+                } else {
+                    gemm4MBlock(mc, nc, kc, aBlock, ia, pa, bBlock, pb, jb,
+                                cBlock, ldc, ic == 0, scratch.get(), product);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief gemm and gemmParallel for complex elements, see gemmComplex
+ */
+template <typename R>
+void gemm(int m, int n, int k, const std::complex<R> *a, std::size_t lda,
+          const std::complex<R> *b, std::size_t ldb, std::complex<R> *c,
+          std::size_t ldc, bool transA = false, bool transB = false) {
+    gemmComplex(m, n, k, a, lda, b, ldb, c, ldc, transA, transB, false,
+                false);
+}
+
+template <typename R>
+void gemmParallel(int m, int n, int k, const std::complex<R> *a,
+                  std::size_t lda, const std::complex<R> *b, std::size_t ldb,
+                  std::complex<R> *c, std::size_t ldc, bool transA = false,
+                  bool transB = false) {
+    gemmComplex(m, n, k, a, lda, b, ldb, c, ldc, transA, transB, false,
+                true);
+}
+
+/**
+ * @brief Multithreaded multiplication, C += A * B, with the 3M method for
+ *        complex elements. Real elements have nothing to save and use
+ *        gemmParallel
+ *
+ * @param m, n, k : C is m x n, A is m x k and B is k x n
+ * @param a, lda : A and its leading dimension
+ * @param b, ldb : B and its leading dimension
+ * @param c, ldc : C and its leading dimension
+ */
+template <typename T>
+void gemm3M(int m, int n, int k, const T *a, std::size_t lda, const T *b,
+            std::size_t ldb, T *c, std::size_t ldc) {
+    gemmParallel(m, n, k, a, lda, b, ldb, c, ldc);
+}
+
+template <typename R>
+void gemm3M(int m, int n, int k, const std::complex<R> *a, std::size_t lda,
+            const std::complex<R> *b, std::size_t ldb, std::complex<R> *c,
+            std::size_t ldc) {
+    gemmComplex(m, n, k, a, lda, b, ldb, c, ldc, false, false, true, true);
+}
+
+/**
+ * @brief Kernels picked for the element-wise operators. Arithmetic types with
+ *        a vectorized specialization below get SIMD kernels, every other type
+ *        keeps the generic scalar ones
+ */
+template <typename T>
+struct ElementwiseDispatch : Elementwise<T> {};
+
+#ifdef MATRIX_HAVE_SIMD
+
+/**
+ * @brief Thin wrappers over the vector intrinsics for one element type, so
+ *        the element-wise kernels can be written once for every type and
+ *        instruction set
+ */
+template <typename T>
+struct SimdOps;
+
+#if defined(MATRIX_SIMD_AVX512)
+
+template <>
+struct SimdOps<float> {
+    typedef __m512 reg;
+    enum { width = 16 };
+    static reg load(const float *p) { return _mm512_loadu_ps(p); }
+    static void store(float *p, reg v) { _mm512_storeu_ps(p, v); }
+    static reg set1(float c) { return _mm512_set1_ps(c); }
+    static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+    static bool eq(reg a, reg b) {
+        return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ) == 0xFFFF;
+    }
+};
+
+template <>
+struct SimdOps<double> {
+    typedef __m512d reg;
+    enum { width = 8 };
+    static reg load(const double *p) { return _mm512_loadu_pd(p); }
+    static void store(double *p, reg v) { _mm512_storeu_pd(p, v); }
+    static reg set1(double c) { return _mm512_set1_pd(c); }
+    static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm512_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+    static bool eq(reg a, reg b) {
+        return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ) == 0xFF;
+    }
+};
+
+template <>
+struct SimdOps<int> {
+    typedef __m512i reg;
+    enum { width = 16 };
+    static reg load(const int *p) { return _mm512_loadu_si512(p); }
+    static void store(int *p, reg v) { _mm512_storeu_si512(p, v); }
+    static reg set1(int c) { return _mm512_set1_epi32(c); }
+    static reg add(reg a, reg b) { return _mm512_add_epi32(a, b); }
+    static reg sub(reg a, reg b) { return _mm512_sub_epi32(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mullo_epi32(a, b); }
+    static bool eq(reg a, reg b) {
+        return _mm512_cmpeq_epi32_mask(a, b) == 0xFFFF;
+    }
+};
+
+#elif defined(MATRIX_SIMD_AVX2)
+
+template <>
+struct SimdOps<float> {
+    typedef __m256 reg;
+    enum { width = 8 };
+    static reg load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, reg v) { _mm256_storeu_ps(p, v); }
+    static reg set1(float c) { return _mm256_set1_ps(c); }
+    static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    static bool eq(reg a, reg b) {
+        return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ)) == 0xFF;
+    }
+};
+
+template <>
+struct SimdOps<double> {
+    typedef __m256d reg;
+    enum { width = 4 };
+    static reg load(const double *p) { return _mm256_loadu_pd(p); }
+    static void store(double *p, reg v) { _mm256_storeu_pd(p, v); }
+    static reg set1(double c) { return _mm256_set1_pd(c); }
+    static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+    static bool eq(reg a, reg b) {
+        return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ)) == 0xF;
+    }
+};
+
+template <>
+struct SimdOps<int> {
+    typedef __m256i reg;
+    enum { width = 8 };
+    static reg load(const int *p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    }
+    static void store(int *p, reg v) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+    }
+    static reg set1(int c) { return _mm256_set1_epi32(c); }
+    static reg add(reg a, reg b) { return _mm256_add_epi32(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_epi32(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mullo_epi32(a, b); }
+    static bool eq(reg a, reg b) {
+        return _mm256_movemask_epi8(_mm256_cmpeq_epi32(a, b)) == -1;
+    }
+};
+
+#else // MATRIX_SIMD_SSE2
+
+template <>
+struct SimdOps<float> {
+    typedef __m128 reg;
+    enum { width = 4 };
+    static reg load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, reg v) { _mm_storeu_ps(p, v); }
+    static reg set1(float c) { return _mm_set1_ps(c); }
+    static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+    static bool eq(reg a, reg b) {
+        return _mm_movemask_ps(_mm_cmpeq_ps(a, b)) == 0xF;
+    }
+};
+
+template <>
+struct SimdOps<double> {
+    typedef __m128d reg;
+    enum { width = 2 };
+    static reg load(const double *p) { return _mm_loadu_pd(p); }
+    static void store(double *p, reg v) { _mm_storeu_pd(p, v); }
+    static reg set1(double c) { return _mm_set1_pd(c); }
+    static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+    static bool eq(reg a, reg b) {
+        return _mm_movemask_pd(_mm_cmpeq_pd(a, b)) == 0x3;
+    }
+};
+
+template <>
+struct SimdOps<int> {
+    typedef __m128i reg;
+    enum { width = 4 };
+    static reg load(const int *p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    }
+    static void store(int *p, reg v) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+    }
+    static reg set1(int c) { return _mm_set1_epi32(c); }
+    static reg add(reg a, reg b) { return _mm_add_epi32(a, b); }
+    static reg sub(reg a, reg b) { return _mm_sub_epi32(a, b); }
+    static reg mul(reg a, reg b) {
+#ifdef __SSE4_1__
+        return _mm_mullo_epi32(a, b);
+#else
+        // SSE2 only multiplies even lanes, so do the odd lanes separately and
+        // interleave the low halves of the 64-bit products
+        reg even = _mm_mul_epu32(a, b);
+        reg odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+        return _mm_unpacklo_epi32(
+            _mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+    }
+    static bool eq(reg a, reg b) {
+        return _mm_movemask_epi8(_mm_cmpeq_epi32(a, b)) == 0xFFFF;
+    }
+};
+
+#endif
+
+/**
+ * @brief Vectorized element-wise kernels: full vectors go through SimdOps<T>
+ *        and the leftover tail falls back to the scalar kernels
+ */
+template <typename T>
+struct SimdElementwise {
+    typedef SimdOps<T> S;
+
+    static void add(const T *a, const T *b, T *out, int n) {
+        int j = 0;
+        for (; j + S::width <= n; j += S::width) {
+            S::store(out + j, S::add(S::load(a + j), S::load(b + j)));
+        }
+        Elementwise<T>::add(a + j, b + j, out + j, n - j);
+    }
+
+    static void sub(const T *a, const T *b, T *out, int n) {
+        int j = 0;
+        for (; j + S::width <= n; j += S::width) {
+            S::store(out + j, S::sub(S::load(a + j), S::load(b + j)));
+        }
+        Elementwise<T>::sub(a + j, b + j, out + j, n - j);
+    }
+
+    static void scale(const T *a, T c, T *out, int n) {
+        const typename S::reg vc = S::set1(c);
+        int j = 0;
+        for (; j + S::width <= n; j += S::width) {
+            S::store(out + j, S::mul(S::load(a + j), vc));
+        }
+        Elementwise<T>::scale(a + j, c, out + j, n - j);
+    }
+
+    static bool equal(const T *a, const T *b, int n) {
+        int j = 0;
+        for (; j + S::width <= n; j += S::width) {
+            if (!S::eq(S::load(a + j), S::load(b + j)))
+                return false;
+        }
+        return Elementwise<T>::equal(a + j, b + j, n - j);
+    }
+
+    static void axpy(const T *a, T c, T *out, int n) {
+        const typename S::reg vc = S::set1(c);
+        int j = 0;
+        for (; j + S::width <= n; j += S::width) {
+            S::store(out + j, S::add(S::load(out + j),
+                                     S::mul(S::load(a + j), vc)));
+        }
+        Elementwise<T>::axpy(a + j, c, out + j, n - j);
+    }
+
+    // Two vector accumulators hide the latency of the additions; the lanes
+    // are summed once at the end
+    static T dot(const T *a, const T *b, int n) {
+        typename S::reg acc0 = S::set1(T());
+        typename S::reg acc1 = S::set1(T());
+        int j = 0;
+        for (; j + 2 * S::width <= n; j += 2 * S::width) {
+            acc0 = S::add(acc0, S::mul(S::load(a + j), S::load(b + j)));
+            acc1 = S::add(acc1, S::mul(S::load(a + j + S::width),
+                                       S::load(b + j + S::width)));
+        }
+        if (j + S::width <= n) {
+            acc0 = S::add(acc0, S::mul(S::load(a + j), S::load(b + j)));
+            j += S::width;
+        }
+        T lanes[S::width];
+        S::store(lanes, S::add(acc0, acc1));
+        T sum = T();
+        for (int l = 0; l < S::width; ++l) {
+            sum += lanes[l];
+        }
+        return sum + Elementwise<T>::dot(a + j, b + j, n - j);
+    }
+};
+
+template <>
+struct ElementwiseDispatch<float> : SimdElementwise<float> {};
+
+template <>
+struct ElementwiseDispatch<double> : SimdElementwise<double> {};
+
+template <>
+struct ElementwiseDispatch<int> : SimdElementwise<int> {};
+
+#endif
+
+/**
+ * @brief out = x + y over an h x w block, row by row
+ */
+template <typename T>
+void blockAdd(int h, int w, const T *x, std::size_t ldx, const T *y,
+              std::size_t ldy, T *out, std::size_t ldo) {
+    for (int i = 0; i < h; ++i) {
+        ElementwiseDispatch<T>::add(x + i * ldx, y + i * ldy, out + i * ldo, w);
+    }
+}
+
+/**
+ * @brief out = x - y over an h x w block, row by row
+ */
+template <typename T>
+void blockSub(int h, int w, const T *x, std::size_t ldx, const T *y,
+              std::size_t ldy, T *out, std::size_t ldo) {
+    for (int i = 0; i < h; ++i) {
+        ElementwiseDispatch<T>::sub(x + i * ldx, y + i * ldy, out + i * ldo, w);
+    }
+}
+
+/**
+ * @brief Blocks with both sides at or below this are transposed directly by
+ *        the cache-oblivious transpose kernels
+ */
+const int TRANSPOSE_BLOCK = 16;
+
+/**
+ * @brief Cache-oblivious out-of-place transpose, B = A^T. The larger side is
+ *        halved recursively until the block fits in cache whatever its size,
+ *        so both the reads and the strided writes stay in cache
+ *
+ * @param m, n : A is m x n and B is n x m
+ * @param a, lda : A and its leading dimension
+ * @param b, ldb : B and its leading dimension
+ */
+template <typename T>
+void transpose(int m, int n, const T *a, std::size_t lda, T *b,
+               std::size_t ldb) {
+    if (m <= TRANSPOSE_BLOCK && n <= TRANSPOSE_BLOCK) {
+        for (int i = 0; i < m; ++i) {
+            for (int j = 0; j < n; ++j) {
+                b[j * ldb + i] = a[i * lda + j];
+            }
+        }
+    } else if (m >= n) {
+        const int h = m / 2;
+        transpose(h, n, a, lda, b, ldb);
+        transpose(m - h, n, a + h * lda, lda, b + h, ldb);
+    } else {
+        const int h = n / 2;
+        transpose(m, h, a, lda, b, ldb);
+        transpose(m, n - h, a + h, lda, b + h * ldb, ldb);
+    }
+}
+
+/**
+ * @brief Swaps the m x n block X with the transpose of the n x m block Y,
+ *        recursing like transpose(). Used for the off-diagonal blocks of the
+ *        in-place transpose
+ */
+template <typename T>
+void swapTransposed(int m, int n, T *x, T *y, std::size_t ld) {
+    if (m <= TRANSPOSE_BLOCK && n <= TRANSPOSE_BLOCK) {
+        for (int i = 0; i < m; ++i) {
+            for (int j = 0; j < n; ++j) {
+                std::swap(x[i * ld + j], y[j * ld + i]);
+            }
+        }
+    } else if (m >= n) {
+        const int h = m / 2;
+        swapTransposed(h, n, x, y, ld);
+        swapTransposed(m - h, n, x + h * ld, y + h, ld);
+    } else {
+        const int h = n / 2;
+        swapTransposed(m, h, x, y, ld);
+        swapTransposed(m, n - h, x + h, y + h * ld, ld);
+    }
+}
+
+/**
+ * @brief Cache-oblivious in-place transpose of a square n x n matrix. The
+ *        diagonal blocks are transposed recursively and the off-diagonal
+ *        blocks swapped with each other's transpose
+ *
+ * @param n : dimension of A
+ * @param a, lda : A and its leading dimension
+ */
+template <typename T>
+void transposeInPlace(int n, T *a, std::size_t lda) {
+    if (n <= TRANSPOSE_BLOCK) {
+        for (int i = 0; i < n; ++i) {
+            for (int j = i + 1; j < n; ++j) {
+                std::swap(a[i * lda + j], a[j * lda + i]);
+            }
+        }
+        return;
+    }
+    const int h = n / 2;
+    transposeInPlace(h, a, lda);
+    transposeInPlace(n - h, a + h * lda + h, lda);
+    swapTransposed(h, n - h, a + h, a + h * lda, lda);
+}
+
+/**
+ * @brief Matrix-vector product, y += op(A) x, for an m x n matrix A. Without
+ *        transposition each y[i] is a dot product with a row of A; with it,
+ *        every row of A is scaled by x[i] and added to y. Either way the
+ *        inner loop runs along a row, through the vectorized kernels
+ *
+ * @param m, n : A is m x n
+ * @param a, lda : A and its leading dimension
+ * @param x : n elements (m if transposed)
+ * @param y : m elements (n if transposed)
+ * @param trans : whether to multiply by A^T
+ */
+template <typename T>
+void gemv(int m, int n, const T *a, std::size_t lda, const T *x, T *y,
+          bool trans = false) {
+    if (trans) {
+        for (int i = 0; i < m; ++i) {
+            ElementwiseDispatch<T>::axpy(a + i * lda, x[i], y, n);
+        }
+        return;
+    }
+    for (int i = 0; i < m; ++i) {
+        y[i] += ElementwiseDispatch<T>::dot(a + i * lda, x, n);
+    }
+}
+
+/**
+ * @brief Multithreaded gemv. y is split into slices (rows of A, or columns
+ *        when transposed) that are computed on the ThreadPool. Products with
+ *        fewer multiply-adds than ParallelConfig::gemmCutoff() run serially
+ */
+template <typename T>
+void gemvParallel(int m, int n, const T *a, std::size_t lda, const T *x,
+                  T *y, bool trans = false) {
+    ThreadPool &pool = ThreadPool::instance();
+    const int threads = pool.getThreadCount();
+    if (threads <= 1 || (long) m * n < ParallelConfig::gemmCutoff()) {
+        gemv(m, n, a, lda, x, y, trans);
+        return;
+    }
+    const int slices = 4 * threads;
+    // Slices cover whole cache lines of y so threads never share one
+    const int line = (int) std::max<std::size_t>(1, 64 / sizeof(T));
+    const int length = trans ? n : m;
+    const int slice = ((length + slices - 1) / slices + line - 1) / line
+                      * line;
+    pool.parallelFor((length + slice - 1) / slice, [=](int t) {
+        const int first = t * slice;
+        const int size = std::min(slice, length - first);
+        if (trans) {
+            gemv(m, size, a + first, lda, x, y + first, true);
+        } else {
+            gemv(size, n, a + first * lda, lda, x, y + first, false);
+        }
+    });
+}
+
+/**
+ * @brief Batch of operands stored at fixed distances from each other, e.g.
+ *        count small matrices packed back to back in one buffer
+ */
+template <typename T>
+struct StridedBatch {
+    const T *a;
+    const T *b;
+    T *c;
+    // Distance (in elements) between consecutive A, B and C operands
+    std::size_t strideA;
+    std::size_t strideB;
+    std::size_t strideC;
+
+    const T *opA(int i) const {
+        return a + i * strideA;
+    }
+
+    const T *opB(int i) const {
+        return b + i * strideB;
+    }
+
+    T *opC(int i) const {
+        return c + i * strideC;
+    }
+};
+
+/**
+ * @brief Unrolled C = A * B for square N x N operands. The bounds are
+ *        compile-time constants, so each row of C is accumulated in
+ *        registers and the inner loop is fully vectorized
+ */
+template <typename T, int N>
+struct FixedGemm {
+    static void run(int, int, int, const T *a, std::size_t lda, const T *b,
+                    std::size_t ldb, T *c, std::size_t ldc) {
+        for (int i = 0; i < N; ++i) {
+            T acc[N];
+            for (int j = 0; j < N; ++j) {
+                acc[j] = T();
+            }
+            for (int p = 0; p < N; ++p) {
+                const T aip = a[i * lda + p];
+                const T *row = b + p * ldb;
+                for (int j = 0; j < N; ++j) {
+                    acc[j] += aip * row[j];
+                }
+            }
+            for (int j = 0; j < N; ++j) {
+                c[i * ldc + j] = acc[j];
+            }
+        }
+    }
+};
+
+/**
+ * @brief C = A * B for operands of any size, through the serial gemm
+ */
+template <typename T>
+struct AnyGemm {
+    static void run(int m, int n, int k, const T *a, std::size_t lda,
+                    const T *b, std::size_t ldb, T *c, std::size_t ldc) {
+        for (int i = 0; i < m; ++i) {
+            std::fill(c + i * ldc, c + i * ldc + n, T());
+        }
+        gemm(m, n, k, a, lda, b, ldb, c, ldc);
+    }
+};
+
+/**
+ * @brief Runs one kernel over a whole batch, in chunks spread across the
+ *        ThreadPool once the batch has ParallelConfig::gemmCutoff()
+ *        multiply-adds
+ */
+template <typename T, typename Kernel, typename Batch>
+void gemmBatchWith(int count, int m, int n, int k, const Batch &batch,
+                   std::size_t lda, std::size_t ldb, std::size_t ldc) {
+    ThreadPool &pool = ThreadPool::instance();
+    const int threads = pool.getThreadCount();
+    if (threads <= 1
+        || (double) count * m * n * k < ParallelConfig::gemmCutoff()) {
+        for (int i = 0; i < count; ++i) {
+            Kernel::run(m, n, k, batch.opA(i), lda, batch.opB(i), ldb,
+                        batch.opC(i), ldc);
+        }
+        return;
+    }
+    const int chunks = std::min(count, 4 * threads);
+    const int chunk = (count + chunks - 1) / chunks;
+    pool.parallelFor((count + chunk - 1) / chunk, [&](int t) {
+        const int last = std::min(count, (t + 1) * chunk);
+        for (int i = t * chunk; i < last; ++i) {
+            Kernel::run(m, n, k, batch.opA(i), lda, batch.opB(i), ldb,
+                        batch.opC(i), ldc);
+        }
+    });
+}
+
+/**
+ * @brief Batched multiplication, C_i = A_i * B_i for i in [0, count), all
+ *        products having the same shape. The kernel is picked once for the
+ *        whole batch: square arithmetic products of size 2, 3, 4, 8, 16 or
+ *        32 get an unrolled kernel, anything else the general one
+ *
+ * @param count : number of products
+ * @param m, n, k : every C_i is m x n, A_i is m x k and B_i is k x n
+ * @param batch : gives the operands of product i through opA(i), opB(i)
+ *                and opC(i)
+ * @param lda, ldb, ldc : leading dimensions shared by all the operands
+ */
+template <typename T, typename Batch>
+void gemmBatched(int count, int m, int n, int k, const Batch &batch,
+                 std::size_t lda, std::size_t ldb, std::size_t ldc) {
+    if (count <= 0 || m == 0 || n == 0) {
+        return;
+    }
+    if (std::is_arithmetic<T>::value && m == n && n == k) {
+        switch (n) {
+            case 2:
+                gemmBatchWith<T, FixedGemm<T, 2>>(count, m, n, k, batch,
+                                                  lda, ldb, ldc);
+                return;
+            case 3:
+                gemmBatchWith<T, FixedGemm<T, 3>>(count, m, n, k, batch,
+                                                  lda, ldb, ldc);
+                return;
+            case 4:
+                gemmBatchWith<T, FixedGemm<T, 4>>(count, m, n, k, batch,
+                                                  lda, ldb, ldc);
+                return;
+            case 8:
+                gemmBatchWith<T, FixedGemm<T, 8>>(count, m, n, k, batch,
+                                                  lda, ldb, ldc);
+                return;
+            case 16:
+                gemmBatchWith<T, FixedGemm<T, 16>>(count, m, n, k, batch,
+                                                   lda, ldb, ldc);
+                return;
+            case 32:
+                gemmBatchWith<T, FixedGemm<T, 32>>(count, m, n, k, batch,
+                                                   lda, ldb, ldc);
+                return;
+            default:
+                break;
+        }
+    }
+    gemmBatchWith<T, AnyGemm<T>>(count, m, n, k, batch, lda, ldb, ldc);
+}
+
+/**
+ * @brief Default size at or below which Strassen-Winograd hands off to the
+ *        blocked kernel. Below this the blocked kernel's efficiency wins over
+ *        the saved multiplications
+ */
+const int STRASSEN_CROSSOVER = 256;
+
+/**
+ * @brief Strassen-Winograd multiplication of square n x n matrices, C = A * B
+ *        (C is overwritten). Uses the 7 multiplication, 15 addition Winograd
+ *        variant with the two-temporary schedule of Boyer, Dumas, Pernet and
+ *        Zhou, so each level only needs 2 (n/2)^2 extra elements. Odd sizes
+ *        are handled by dynamic peeling: the even leading part recurses and
+ *        the last row and column are fixed up with thin products. Blocks of
+ *        size crossover or less go to the (parallel) blocked kernel
+ *
+ * @param n : dimension of A, B and C
+ * @param a, lda : A and its leading dimension
+ * @param b, ldb : B and its leading dimension
+ * @param c, ldc : C and its leading dimension
+ * @param crossover : size at or below which the blocked kernel is used
+ */
+template <typename T>
+void strassen(int n, const T *a, std::size_t lda, const T *b,
+              std::size_t ldb, T *c, std::size_t ldc, int crossover) {
+    if (n <= crossover || n < 2) {
+        for (int i = 0; i < n; ++i) {
+            std::fill(c + i * ldc, c + i * ldc + n, T());
+        }
+        gemmParallel(n, n, n, a, lda, b, ldb, c, ldc);
+        return;
+    }
+    if (n % 2 != 0) {
+        // Peel the last row and column off an even leading part
+        const int e = n - 1;
+        strassen(e, a, lda, b, ldb, c, ldc, crossover);
+        // C11 += a12 * b21 (rank one update)
+        gemm(e, e, 1, a + e, lda, b + e * ldb, ldb, c, ldc);
+        // Last column and last row of C over the full depth
+        for (int i = 0; i < n; ++i) {
+            c[i * ldc + e] = T();
+        }
+        std::fill(c + e * ldc, c + e * ldc + e, T());
+        gemm(n, 1, n, a, lda, b + e, ldb, c + e, ldc);
+        gemm(1, e, n, a + e * lda, lda, b, ldb, c + e * ldc, ldc);
+        return;
+    }
+    const int h = n / 2;
+    const T *a11 = a, *a12 = a + h, *a21 = a + h * lda, *a22 = a21 + h;
+    const T *b11 = b, *b12 = b + h, *b21 = b + h * ldb, *b22 = b21 + h;
+    T *c11 = c, *c12 = c + h, *c21 = c + h * ldc, *c22 = c21 + h;
+    const std::size_t ld = h;
+    std::vector<T> tmp(2 * (std::size_t) h * h);
+    T *x = tmp.data();
+    T *y = x + (std::size_t) h * h;
+
+    blockSub(h, h, a11, lda, a21, lda, x, ld);          // S3 = A11 - A21
+    blockSub(h, h, b22, ldb, b12, ldb, y, ld);          // T3 = B22 - B12
+    strassen(h, x, ld, y, ld, c21, ldc, crossover);     // P7 = S3 T3
+    blockAdd(h, h, a21, lda, a22, lda, x, ld);          // S1 = A21 + A22
+    blockSub(h, h, b12, ldb, b11, ldb, y, ld);          // T1 = B12 - B11
+    strassen(h, x, ld, y, ld, c22, ldc, crossover);     // P5 = S1 T1
+    blockSub(h, h, x, ld, a11, lda, x, ld);             // S2 = S1 - A11
+    blockSub(h, h, b22, ldb, y, ld, y, ld);             // T2 = B22 - T1
+    strassen(h, x, ld, y, ld, c12, ldc, crossover);     // P6 = S2 T2
+    blockSub(h, h, a12, lda, x, ld, x, ld);             // S4 = A12 - S2
+    strassen(h, x, ld, b22, ldb, c11, ldc, crossover);  // P3 = S4 B22
+    strassen(h, a11, lda, b11, ldb, x, ld, crossover);  // P1 = A11 B11
+    blockAdd(h, h, x, ld, c12, ldc, c12, ldc);          // U2 = P1 + P6
+    blockAdd(h, h, c12, ldc, c21, ldc, c21, ldc);       // U3 = U2 + P7
+    blockAdd(h, h, c12, ldc, c22, ldc, c12, ldc);       // U4 = U2 + P5
+    blockAdd(h, h, c21, ldc, c22, ldc, c22, ldc);       // U7 = U3 + P5
+    blockAdd(h, h, c12, ldc, c11, ldc, c12, ldc);       // U5 = U4 + P3
+    blockSub(h, h, y, ld, b21, ldb, y, ld);             // T4 = T2 - B21
+    strassen(h, a22, lda, y, ld, c11, ldc, crossover);  // P4 = A22 T4
+    blockSub(h, h, c21, ldc, c11, ldc, c21, ldc);       // U6 = U3 - P4
+    strassen(h, a12, lda, b21, ldb, c11, ldc, crossover); // P2 = A12 B21
+    blockAdd(h, h, x, ld, c11, ldc, c11, ldc);          // U1 = P1 + P2
+}
+
+} // namespace matrix_kernels
+
+#endif
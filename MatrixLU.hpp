@@ -0,0 +1,476 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      MatrixLU.hpp
+//
+// Author:         Sahib Pandori and Haylee Monteiro
+// CS email:       sahib@cs.wisc.edu and haylee@cs.wisc.edu
+//
+// Description:    This file contains the blocked LU factorization and the
+//                 solve(), inverse() and determinant() built on it
+///////////////////////////////////////////////////////////////////////////////
+#ifndef MATRIX_LU_H
+#define MATRIX_LU_H
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Matrix.hpp"
+
+class SingularMatrix : public std::exception {
+private:
+    std::string message;
+public:
+    explicit SingularMatrix(int n) {
+        this->message = "Singular Matrix Exception: matrix with dimensions "
+                        + std::to_string(n) + " x " + std::to_string(n)
+                        + " is singular\n";
+    }
+
+    virtual const char* what() const throw() {
+        return message.c_str();
+    }
+};
+
+class NonSquareMatrix : public std::exception {
+private:
+    std::string message;
+public:
+    NonSquareMatrix(int rows, int cols) {
+        this->message = "Non-Square Matrix Exception: matrix with dimensions "
+                        + std::to_string(rows) + " x " + std::to_string(cols)
+                        + " is not square\n";
+    }
+
+    virtual const char* what() const throw() {
+        return message.c_str();
+    }
+};
+
+namespace matrix_kernels {
+
+// Element types LU can factor: real and complex floating point
+template <typename T>
+struct IsFieldType : std::is_floating_point<T> {};
+
+template <typename R>
+struct IsFieldType<std::complex<R>> : std::is_floating_point<R> {};
+
+// Width of the column panels factored between two trailing updates, and of
+// the row blocks of the triangular solves
+const int LU_BLOCK = 64;
+
+/**
+ * @brief C -= A * B on the thread pool. gemm only accumulates, so A is copied
+ *        negated into scratch first
+ */
+template <typename T>
+void gemmSubtract(int m, int n, int k, const T *a, std::size_t lda,
+                  const T *b, std::size_t ldb, T *c, std::size_t ldc,
+                  std::vector<T, AlignedAllocator<T>> &scratch) {
+    if (m == 0 || n == 0 || k == 0) {
+        return;
+    }
+    if (scratch.size() < (std::size_t) m * k) {
+        scratch.resize((std::size_t) m * k);
+    }
+    for (int i = 0; i < m; ++i) {
+        ElementwiseDispatch<T>::scale(a + i * lda, T(-1),
+                                      scratch.data() + (std::size_t) i * k,
+                                      k);
+    }
+    gemmParallel(m, n, k, scratch.data(), (std::size_t) k, b, ldb, c, ldc);
+}
+
+/**
+ * @brief Blocked right-looking LU factorization with partial pivoting,
+ *        P A = L U, in place. Each panel of LU_BLOCK columns is factored
+ *        unblocked, then U is extended to the right of it by a triangular
+ *        solve and the rest of the matrix is updated with one gemm, where
+ *        almost all of the work is
+ *
+ * @param n : A is n x n
+ * @param a, lda : A and its leading dimension. Receives U on and above the
+ *                 diagonal and L (whose unit diagonal is not stored) below
+ * @param pivots : n entries; row i was swapped with row pivots[i] >= i
+ * @return false if a pivot was exactly zero, i.e. A is singular. The
+ *         factorization is completed anyway
+ */
+template <typename T>
+bool luFactor(int n, T *a, std::size_t lda, int *pivots) {
+    std::vector<T, AlignedAllocator<T>> scratch;
+    bool regular = true;
+    for (int j0 = 0; j0 < n; j0 += LU_BLOCK) {
+        const int end = std::min(n, j0 + LU_BLOCK);
+        for (int j = j0; j < end; ++j) {
+            int p = j;
+            auto largest = std::abs(a[j * lda + j]);
+            for (int i = j + 1; i < n; ++i) {
+                const auto size = std::abs(a[i * lda + j]);
+                if (size > largest) {
+                    largest = size;
+                    p = i;
+                }
+            }
+            pivots[j] = p;
+            // Whole rows are swapped, so L is stored already permuted
+            if (p != j) {
+                std::swap_ranges(a + j * lda, a + j * lda + n, a + p * lda);
+            }
+            const T pivot = a[j * lda + j];
+            if (pivot == T()) {
+                regular = false;
+                continue;
+            }
+            const T reciprocal = T(1) / pivot;
+            for (int i = j + 1; i < n; ++i) {
+                T *row = a + i * lda;
+                row[j] *= reciprocal;
+                ElementwiseDispatch<T>::axpy(a + j * lda + j + 1, -row[j],
+                                             row + j + 1, end - j - 1);
+            }
+        }
+        if (end == n) {
+            break;
+        }
+        // U12 = L11^-1 A12
+        for (int i = j0 + 1; i < end; ++i) {
+            T *row = a + i * lda;
+            for (int p = j0; p < i; ++p) {
+                ElementwiseDispatch<T>::axpy(a + p * lda + end, -row[p],
+                                             row + end, n - end);
+            }
+        }
+        // A22 -= L21 U12
+        gemmSubtract(n - end, n - end, end - j0, a + end * lda + j0, lda,
+                     a + j0 * lda + end, lda, a + end * lda + end, lda,
+                     scratch);
+    }
+    return regular;
+}
+
+// sum of a[j] * x[j * incx]
+template <typename T>
+T dotStrided(const T *a, const T *x, std::size_t incx, int n) {
+    if (incx == 1) {
+        return ElementwiseDispatch<T>::dot(a, x, n);
+    }
+    T sum = T();
+    for (int j = 0; j < n; ++j) {
+        sum += a[j] * x[j * incx];
+    }
+    return sum;
+}
+
+/**
+ * @brief Solves A X = B in place from the factorization of luFactor(). Both
+ *        triangular solves are blocked like the factorization, except for a
+ *        single right-hand side, which is solved row by row with dot products
+ *
+ * @param n : A is n x n
+ * @param lu, lda : the factors and their leading dimension
+ * @param pivots : the row swaps
+ * @param r : number of right-hand sides (columns of B)
+ * @param b, ldb : B and its leading dimension; receives X
+ */
+template <typename T>
+void luSolve(int n, const T *lu, std::size_t lda, const int *pivots, int r,
+             T *b, std::size_t ldb) {
+    for (int i = 0; i < n; ++i) {
+        if (pivots[i] != i) {
+            std::swap_ranges(b + i * ldb, b + i * ldb + r,
+                             b + pivots[i] * ldb);
+        }
+    }
+    if (r == 1) {
+        for (int i = 0; i < n; ++i) {
+            b[i * ldb] -= dotStrided(lu + i * lda, b, ldb, i);
+        }
+        for (int i = n - 1; i >= 0; --i) {
+            b[i * ldb] -= dotStrided(lu + i * lda + i + 1, b + (i + 1) * ldb,
+                                     ldb, n - i - 1);
+            b[i * ldb] /= lu[i * lda + i];
+        }
+        return;
+    }
+    std::vector<T, AlignedAllocator<T>> scratch;
+    // L Y = P B, top down
+    for (int i0 = 0; i0 < n; i0 += LU_BLOCK) {
+        const int end = std::min(n, i0 + LU_BLOCK);
+        for (int i = i0 + 1; i < end; ++i) {
+            for (int p = i0; p < i; ++p) {
+                ElementwiseDispatch<T>::axpy(b + p * ldb, -lu[i * lda + p],
+                                             b + i * ldb, r);
+            }
+        }
+        gemmSubtract(n - end, r, end - i0, lu + end * lda + i0, lda,
+                     b + i0 * ldb, ldb, b + end * ldb, ldb, scratch);
+    }
+    // U X = Y, bottom up
+    for (int i0 = (n - 1) / LU_BLOCK * LU_BLOCK; i0 >= 0; i0 -= LU_BLOCK) {
+        const int end = std::min(n, i0 + LU_BLOCK);
+        gemmSubtract(end - i0, r, n - end, lu + i0 * lda + end, lda,
+                     b + end * ldb, ldb, b + i0 * ldb, ldb, scratch);
+        for (int i = end - 1; i >= i0; --i) {
+            T *row = b + i * ldb;
+            for (int p = i + 1; p < end; ++p) {
+                ElementwiseDispatch<T>::axpy(b + p * ldb, -lu[i * lda + p],
+                                             row, r);
+            }
+            ElementwiseDispatch<T>::scale(row, T(1) / lu[i * lda + i], row,
+                                          r);
+        }
+    }
+}
+
+} // namespace matrix_kernels
+
+/**
+ * @brief LU factorization with partial pivoting, P A = L U, of a square
+ *        matrix. Factoring costs O(n^3) once; every solve with the result
+ *        then costs O(n^2) per right-hand side, so systems sharing a matrix
+ *        should share one factorization
+ *
+ *     LUDecomposition<double> f(a);
+ *     for (...) {
+ *         x = f.solve(b);
+ *     }
+ */
+template <typename T, typename Check = CheckedAccess,
+          typename Alloc = AlignedAllocator<T>>
+class LUDecomposition {
+    static_assert(matrix_kernels::IsFieldType<T>::value,
+                  "LU factorization needs floating point or complex elements");
+private:
+    // L below the diagonal, U on and above it
+    Matrix<T, Check, Alloc> factors;
+    std::vector<int> pivots;
+    bool regular;
+
+    void factor() {
+        if (factors.getRows() != factors.getCols()) {
+            throw NonSquareMatrix(factors.getRows(), factors.getCols());
+        }
+        const int n = factors.getRows();
+        pivots.resize((std::size_t) n);
+        regular = n == 0
+                  || matrix_kernels::luFactor(n, factors.rowData(0),
+                                              (std::size_t)
+                                                  factors.getStride(),
+                                              pivots.data());
+    }
+
+    void requireRegular() const {
+        if (!regular) {
+            throw SingularMatrix(size());
+        }
+    }
+public:
+    /**
+     * @brief Factors a copy of a square matrix
+     *
+     * @param a : the matrix to be factored
+     */
+    explicit LUDecomposition(const Matrix<T, Check, Alloc> &a)
+            : factors(a), regular(true) {
+        factor();
+    }
+
+    /**
+     * @brief Factors a square matrix in its own storage
+     *
+     * @param a : the matrix to be factored, moved from
+     */
+    explicit LUDecomposition(Matrix<T, Check, Alloc> &&a)
+            : factors(std::move(a)), regular(true) {
+        factor();
+    }
+
+    /**
+     * @brief Returns the order of the factored matrix
+     *
+     * @return the number of rows (and columns)
+     */
+    int size() const {
+        return factors.getRows();
+    }
+
+    /**
+     * @brief Checks whether the matrix is singular, i.e. a pivot was exactly
+     *        zero. Nearly singular matrices are not detected
+     *
+     * @return true if the matrix has no inverse
+     */
+    bool isSingular() const {
+        return !regular;
+    }
+
+    /**
+     * @brief Returns L and U packed in one matrix: U on and above the
+     *        diagonal, L below it (its diagonal is all ones)
+     *
+     * @return the factors
+     */
+    const Matrix<T, Check, Alloc> &getFactors() const {
+        return factors;
+    }
+
+    /**
+     * @brief Returns the row swaps: row i was swapped with row getPivots()[i]
+     *        in order of increasing i
+     *
+     * @return the pivots
+     */
+    const std::vector<int> &getPivots() const {
+        return pivots;
+    }
+
+    /**
+     * @brief Returns the determinant, the product of the pivots with the
+     *        sign of the permutation
+     *
+     * @return the determinant; zero for singular matrices
+     */
+    T determinant() const {
+        T det = T(1);
+        for (int i = 0; i < size(); ++i) {
+            det *= factors.rowData(i)[i];
+            if (pivots[i] != i) {
+                det = -det;
+            }
+        }
+        return det;
+    }
+
+    /**
+     * @brief Solves A X = B for every column of B at once, overwriting B
+     *
+     * @param b : size() x r right-hand sides; receives the solutions
+     */
+    void solveInPlace(Matrix<T, Check, Alloc> &b) const {
+        if (b.getRows() != size()) {
+            throw IncompatibleMatrices('*', size(), size(), b.getRows(),
+                                       b.getCols());
+        }
+        requireRegular();
+        if (size() == 0 || b.getCols() == 0) {
+            return;
+        }
+        matrix_kernels::luSolve(size(), factors.rowData(0),
+                                (std::size_t) factors.getStride(),
+                                pivots.data(), b.getCols(), b.rowData(0),
+                                (std::size_t) b.getStride());
+    }
+
+    /**
+     * @brief Solves A X = B
+     *
+     * @param b : size() x r right-hand sides
+     * @return the solutions X, size() x r
+     */
+    Matrix<T, Check, Alloc> solve(const Matrix<T, Check, Alloc> &b) const {
+        Matrix<T, Check, Alloc> x = b;
+        solveInPlace(x);
+        return x;
+    }
+
+    /**
+     * @brief Solves A x = b
+     *
+     * @param b : the right-hand side, size() elements
+     * @return the solution x
+     */
+    std::vector<T> solve(const std::vector<T> &b) const {
+        if (b.size() != (std::size_t) size()) {
+            throw IncompatibleMatrices('*', size(), size(), (int) b.size(), 1);
+        }
+        requireRegular();
+        std::vector<T> x = b;
+        if (size() > 0) {
+            matrix_kernels::luSolve(size(), factors.rowData(0),
+                                    (std::size_t) factors.getStride(),
+                                    pivots.data(), 1, x.data(), 1);
+        }
+        return x;
+    }
+
+    /**
+     * @brief Returns the inverse, by solving A X = I
+     *
+     * @return A^-1
+     */
+    Matrix<T, Check, Alloc> inverse() const {
+        Matrix<T, Check, Alloc> x(size(), size());
+        for (int i = 0; i < size(); ++i) {
+            x.rowData(i)[i] = T(1);
+        }
+        solveInPlace(x);
+        return x;
+    }
+};
+
+/**
+ * @brief Factors a square matrix. See LUDecomposition
+ *
+ * @param a : the matrix to be factored
+ * @return the factorization, to be reused across solves
+ */
+template <typename T, typename Check, typename Alloc>
+LUDecomposition<T, Check, Alloc> luDecompose(
+        const Matrix<T, Check, Alloc> &a) {
+    return LUDecomposition<T, Check, Alloc>(a);
+}
+
+/**
+ * @brief Solves the linear system A X = B
+ *
+ * @param a : the square matrix A
+ * @param b : right-hand sides, one per column
+ * @return the solutions X
+ */
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> solve(const Matrix<T, Check, Alloc> &a,
+                              const Matrix<T, Check, Alloc> &b) {
+    return LUDecomposition<T, Check, Alloc>(a).solve(b);
+}
+
+/**
+ * @brief Solves the linear system A x = b
+ *
+ * @param a : the square matrix A
+ * @param b : the right-hand side
+ * @return the solution x
+ */
+template <typename T, typename Check, typename Alloc>
+std::vector<T> solve(const Matrix<T, Check, Alloc> &a,
+                     const std::vector<T> &b) {
+    return LUDecomposition<T, Check, Alloc>(a).solve(b);
+}
+
+/**
+ * @brief Returns the inverse of a square matrix. Solving with solve() is
+ *        faster and more accurate than multiplying by the inverse
+ *
+ * @param a : the matrix to be inverted
+ * @return A^-1
+ */
+template <typename T, typename Check, typename Alloc>
+Matrix<T, Check, Alloc> inverse(const Matrix<T, Check, Alloc> &a) {
+    return LUDecomposition<T, Check, Alloc>(a).inverse();
+}
+
+/**
+ * @brief Returns the determinant of a square matrix
+ *
+ * @param a : the matrix
+ * @return det(A)
+ */
+template <typename T, typename Check, typename Alloc>
+T determinant(const Matrix<T, Check, Alloc> &a) {
+    return LUDecomposition<T, Check, Alloc>(a).determinant();
+}
+
+#endif
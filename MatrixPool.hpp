@@ -0,0 +1,202 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      MatrixPool.hpp
+//
+// Author:         Sahib Pandori and Haylee Monteiro
+// CS email:       sahib@cs.wisc.edu and haylee@cs.wisc.edu
+//
+// Description:    This file contains the scoped buffer pool and the allocator
+//                 that lets Matrix temporaries recycle their storage
+///////////////////////////////////////////////////////////////////////////////
+#ifndef MATRIX_POOL_H
+#define MATRIX_POOL_H
+
+#include <cstddef>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "Matrix.hpp"
+
+/**
+ * @brief Cache of released Matrix buffers, grouped by size in bytes. A pool
+ *        is a scope object: while it is alive it is the current pool of the
+ *        thread that created it, buffers released through PoolAllocator on
+ *        that thread are kept in it instead of being freed, and allocations of
+ *        the same size take them back. A loop of same-sized operations
+ *        therefore stops calling malloc after its first iteration, and
+ *        threads stop contending on the global heap. Pools nest; destroying
+ *        one frees every buffer it holds and makes the enclosing pool current
+ *        again
+ *
+ *     MatrixPool pool;
+ *     for (...) {
+ *         PooledMatrix<double> c = a * b + d;  // reuses last iteration's c
+ *     }
+ */
+class MatrixPool {
+private:
+    typedef AlignedAllocator<char> Raw;
+
+    // Released buffers, by size
+    std::unordered_map<std::size_t, std::vector<char *>> blocks;
+    // Total size of the cached buffers, and the most that may be cached
+    std::size_t held;
+    std::size_t limit;
+    // Pool that was current when this one was created
+    MatrixPool *outer;
+
+    static MatrixPool *&current() {
+        static thread_local MatrixPool *pool = nullptr;
+        return pool;
+    }
+public:
+    /**
+     * @brief Creates a pool and makes it the current pool of this thread
+     *
+     * @param maxBytes : most memory the pool keeps cached; buffers released
+     *                   past it are freed. Unlimited by default
+     */
+    explicit MatrixPool(
+            std::size_t maxBytes = std::numeric_limits<std::size_t>::max())
+            : held(0), limit(maxBytes), outer(current()) {
+        current() = this;
+    }
+
+    MatrixPool(const MatrixPool &) = delete;
+    MatrixPool &operator=(const MatrixPool &) = delete;
+
+    /**
+     * @brief Frees every cached buffer and makes the enclosing pool current
+     *        again. Pools have to be destroyed in reverse order of creation,
+     *        which scoping guarantees
+     */
+    ~MatrixPool() {
+        clear();
+        current() = outer;
+    }
+
+    /**
+     * @brief Returns the pool PoolAllocator uses on the calling thread
+     *
+     * @return the innermost live pool of this thread, or nullptr if none
+     */
+    static MatrixPool *active() {
+        return current();
+    }
+
+    /**
+     * @brief Returns a buffer of the given size, reusing a cached one if
+     *        there is one. Buffers are aligned like AlignedAllocator's
+     *
+     * @param bytes : size of the buffer
+     * @return the buffer
+     */
+    char *allocate(std::size_t bytes) {
+        auto it = blocks.find(bytes);
+        if (it != blocks.end() && !it->second.empty()) {
+            char *p = it->second.back();
+            it->second.pop_back();
+            held -= bytes;
+            return p;
+        }
+        return Raw().allocate(bytes);
+    }
+
+    /**
+     * @brief Takes back a buffer obtained from allocate() (or from any
+     *        AlignedAllocator) so a later allocation of the same size can
+     *        reuse it. The buffer is freed if the pool is full
+     *
+     * @param p : the buffer
+     * @param bytes : its size
+     */
+    void release(char *p, std::size_t bytes) {
+        if (p == nullptr) {
+            return;
+        }
+        if (bytes > limit - held) {
+            Raw().deallocate(p, bytes);
+            return;
+        }
+        blocks[bytes].push_back(p);
+        held += bytes;
+    }
+
+    /**
+     * @brief Returns the amount of memory held in cached buffers
+     *
+     * @return the size of the cached buffers, in bytes
+     */
+    std::size_t cachedBytes() const {
+        return held;
+    }
+
+    /**
+     * @brief Frees every cached buffer
+     */
+    void clear() {
+        for (auto &sized : blocks) {
+            for (char *p : sized.second) {
+                Raw().deallocate(p, sized.first);
+            }
+            sized.second.clear();
+        }
+        held = 0;
+    }
+};
+
+/**
+ * @brief Allocator that draws from the calling thread's current MatrixPool,
+ *        and behaves like AlignedAllocator when there is none. Buffers can be
+ *        released on any thread and inside or outside any pool, so matrices
+ *        using it can be moved and returned freely
+ */
+template <typename T>
+struct PoolAllocator {
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U> other;
+    };
+
+    PoolAllocator() {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &) {}
+
+    T *allocate(std::size_t n) {
+        MatrixPool *pool = MatrixPool::active();
+        if (pool == nullptr) {
+            return AlignedAllocator<T>().allocate(n);
+        }
+        return reinterpret_cast<T *>(pool->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, std::size_t n) {
+        MatrixPool *pool = MatrixPool::active();
+        if (pool == nullptr) {
+            AlignedAllocator<T>().deallocate(p, n);
+        } else {
+            pool->release(reinterpret_cast<char *>(p), n * sizeof(T));
+        }
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+    return false;
+}
+
+/**
+ * @brief Matrix whose storage comes from the current MatrixPool
+ */
+template <typename T, typename Check = CheckedAccess>
+using PooledMatrix = Matrix<T, Check, PoolAllocator<T>>;
+
+#endif
@@ -0,0 +1,607 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      SparseMatrix.hpp
+//
+// Author:         Sahib Pandori and Haylee Monteiro
+// CS email:       sahib@cs.wisc.edu and haylee@cs.wisc.edu
+//
+// Description:    This file contains the compressed sparse (CSR/CSC) matrix
+//                 and its operations with the dense Matrix
+///////////////////////////////////////////////////////////////////////////////
+#ifndef SPARSE_MATRIX_H
+#define SPARSE_MATRIX_H
+
+#include <algorithm>
+#include <vector>
+
+#include "Matrix.hpp"
+
+class InvalidSparseStructure : public std::exception {
+private:
+    std::string message;
+public:
+    explicit InvalidSparseStructure(const std::string &reason) {
+        this->message = "Invalid Sparse Structure Exception: " + reason + "\n";
+    }
+
+    virtual const char* what() const throw() {
+        return message.c_str();
+    }
+};
+
+/**
+ * @brief Which dimension a SparseMatrix is compressed along
+ */
+enum SparseFormat {
+    // Compressed sparse rows: offsets index rows, indices hold columns
+    CSR,
+    // Compressed sparse columns: offsets index columns, indices hold rows
+    CSC
+};
+
+template <typename T>
+class SparseMatrix {
+private:
+    // Number of rows in the matrix
+    int row;
+    // Number of columns in the matrix
+    int col;
+    // Whether the storage is compressed by rows or by columns
+    SparseFormat format;
+    // offsets[o] .. offsets[o + 1] is the range of entries of outer index o
+    std::vector<int> offsets;
+    // Inner index (column for CSR, row for CSC) of every stored entry, sorted
+    // within each outer index
+    std::vector<int> indices;
+    // Value of every stored entry
+    std::vector<T> values;
+
+    /**
+     * @brief Returns the number of outer indices (rows for CSR, columns for
+     *        CSC)
+     */
+    int outerSize() const {
+        return format == CSR ? row : col;
+    }
+public:
+    /**
+     * @brief Constructor to initialize an all-zero sparse matrix with r rows
+     *        and c columns
+     *
+     * @param r : number of rows
+     * @param c : number of columns
+     * @param f : storage format
+     */
+    SparseMatrix(int r, int c, SparseFormat f = CSR);
+
+    /**
+     * @brief Constructor that adopts already compressed arrays. Throws
+     *        InvalidSparseStructure if they do not describe a valid matrix
+     *
+     * @param r : number of rows
+     * @param c : number of columns
+     * @param offsets : outer offsets, one more than the number of rows (CSR)
+     *                  or columns (CSC)
+     * @param indices : inner index of every entry, sorted within each outer
+     *                  index
+     * @param values : value of every entry
+     * @param f : storage format the arrays are in
+     */
+    SparseMatrix(int r, int c, std::vector<int> offsets,
+                 std::vector<int> indices, std::vector<T> values,
+                 SparseFormat f = CSR);
+
+    /**
+     * @brief Constructor that compresses a dense Matrix, keeping only its
+     *        non-zero elements
+     *
+     * @param m : the dense matrix
+     * @param f : storage format
+     */
+    explicit SparseMatrix(const Matrix<T> &m, SparseFormat f = CSR);
+
+    /**
+     * @brief Returns the number of rows in the matrix
+     *
+     * @return number of rows
+     */
+    int getRows() const;
+
+    /**
+     * @brief Returns the number of columns in the matrix
+     *
+     * @return number of columns
+     */
+    int getCols() const;
+
+    /**
+     * @brief Returns the storage format
+     *
+     * @return CSR or CSC
+     */
+    SparseFormat getFormat() const;
+
+    /**
+     * @brief Returns the number of stored entries
+     *
+     * @return number of stored entries
+     */
+    int getNonZeros() const;
+
+    /**
+     * @brief Accessors for the compressed arrays
+     */
+    const std::vector<int> &getOffsets() const;
+    const std::vector<int> &getIndices() const;
+    const std::vector<T> &getValues() const;
+
+    /**
+     * @brief Returns the element at row i, column j (zero if not stored)
+     *
+     * @param i : row of the element
+     * @param j : column of the element
+     * @return the value of the element
+     */
+    T at(int i, int j) const;
+
+    /**
+     * @brief Converts to the given storage format
+     *
+     * @param f : the storage format wanted
+     * @return a copy of the matrix in format f
+     */
+    SparseMatrix<T> convert(SparseFormat f) const;
+
+    /**
+     * @brief Expands to a dense Matrix
+     *
+     * @return the dense equivalent of the calling object
+     */
+    Matrix<T> toDense() const;
+
+    /**
+     * @brief Multiplies with a dense matrix
+     *
+     * @param m : the dense matrix to be multiplied to the calling object
+     * @return the (dense) product of the calling object and m
+     */
+    Matrix<T> operator*(const Matrix<T> &m) const;
+
+    /**
+     * @brief Multiplies with another sparse matrix (Gustavson's algorithm)
+     *
+     * @param m : the sparse matrix to be multiplied to the calling object
+     * @return the CSR product of the calling object and m
+     */
+    SparseMatrix<T> operator*(const SparseMatrix &m) const;
+
+    /**
+     * @brief Adds a dense matrix
+     *
+     * @param m : the dense matrix to be added to the calling object
+     * @return the (dense) sum of the calling object and m
+     */
+    Matrix<T> operator+(const Matrix<T> &m) const;
+
+    /**
+     * @brief Compares with another sparse matrix element by element, so
+     *        matrices with different formats or explicitly stored zeros still
+     *        compare equal when their values match
+     *
+     * @param m : the matrix to be compared to the calling object
+     * @return true if the matrices are equal, false otherwise
+     */
+    bool operator==(const SparseMatrix &m) const;
+
+    /**
+     * @brief Compares with a dense matrix element by element
+     *
+     * @param m : the matrix to be compared to the calling object
+     * @return true if the matrices are equal, false otherwise
+     */
+    bool operator==(const Matrix<T> &m) const;
+
+    bool operator!=(const SparseMatrix &m) const;
+
+    bool operator!=(const Matrix<T> &m) const;
+};
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix(int r, int c, SparseFormat f)
+        : row(r), col(c), format(f) {
+    if (r < 0 || c < 0) {
+        throw InvalidDimension(r, c);
+    }
+    offsets.assign((std::size_t) outerSize() + 1, 0);
+}
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix(int r, int c, std::vector<int> offsets,
+                              std::vector<int> indices, std::vector<T> values,
+                              SparseFormat f)
+        : row(r), col(c), format(f), offsets(std::move(offsets)),
+          indices(std::move(indices)), values(std::move(values)) {
+    if (r < 0 || c < 0) {
+        throw InvalidDimension(r, c);
+    }
+    const int outer = outerSize();
+    if (this->offsets.size() != (std::size_t) outer + 1) {
+        throw InvalidSparseStructure(
+            std::to_string(this->offsets.size()) + " offsets given for "
+            + std::to_string(outer) + (format == CSR ? " rows" : " columns"));
+    }
+    if (this->offsets[0] != 0) {
+        throw InvalidSparseStructure("offsets must start at 0");
+    }
+    if (this->indices.size() != this->values.size()
+        || (std::size_t) this->offsets[outer] != this->indices.size()) {
+        throw InvalidSparseStructure(
+            "the last offset, the number of indices and the number of values "
+            "must be equal");
+    }
+    const int inner = format == CSR ? col : row;
+    for (int o = 0; o < outer; ++o) {
+        if (this->offsets[o + 1] < this->offsets[o]) {
+            throw InvalidSparseStructure("offsets must not decrease");
+        }
+        for (int e = this->offsets[o]; e < this->offsets[o + 1]; ++e) {
+            const int idx = this->indices[e];
+            if (idx < 0 || idx >= inner) {
+                throw IndexOutOfBounds(idx);
+            }
+            if (e > this->offsets[o] && idx <= this->indices[e - 1]) {
+                throw InvalidSparseStructure(
+                    "indices must be sorted and unique within each "
+                    + std::string(format == CSR ? "row" : "column"));
+            }
+        }
+    }
+}
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix(const Matrix<T> &m, SparseFormat f)
+        : row(m.getRows()), col(m.getCols()), format(f) {
+    offsets.reserve((std::size_t) outerSize() + 1);
+    offsets.push_back(0);
+    if (format == CSR) {
+        for (int i = 0; i < row; ++i) {
+            const T *in = m.rowData(i);
+            for (int j = 0; j < col; ++j) {
+                if (in[j] != T()) {
+                    indices.push_back(j);
+                    values.push_back(in[j]);
+                }
+            }
+            offsets.push_back((int) indices.size());
+        }
+    } else {
+        for (int j = 0; j < col; ++j) {
+            for (int i = 0; i < row; ++i) {
+                const T v = m.rowData(i)[j];
+                if (v != T()) {
+                    indices.push_back(i);
+                    values.push_back(v);
+                }
+            }
+            offsets.push_back((int) indices.size());
+        }
+    }
+}
+
+template <typename T>
+int SparseMatrix<T>::getRows() const {
+    return this->row;
+}
+
+template <typename T>
+int SparseMatrix<T>::getCols() const {
+    return this->col;
+}
+
+template <typename T>
+SparseFormat SparseMatrix<T>::getFormat() const {
+    return this->format;
+}
+
+template <typename T>
+int SparseMatrix<T>::getNonZeros() const {
+    return (int) values.size();
+}
+
+template <typename T>
+const std::vector<int> &SparseMatrix<T>::getOffsets() const {
+    return offsets;
+}
+
+template <typename T>
+const std::vector<int> &SparseMatrix<T>::getIndices() const {
+    return indices;
+}
+
+template <typename T>
+const std::vector<T> &SparseMatrix<T>::getValues() const {
+    return values;
+}
+
+template <typename T>
+T SparseMatrix<T>::at(int i, int j) const {
+    if (i < 0 || i >= row) {
+        throw IndexOutOfBounds(i);
+    }
+    if (j < 0 || j >= col) {
+        throw IndexOutOfBounds(j);
+    }
+    const int outer = format == CSR ? i : j;
+    const int inner = format == CSR ? j : i;
+    const int *first = indices.data() + offsets[outer];
+    const int *last = indices.data() + offsets[outer + 1];
+    const int *pos = std::lower_bound(first, last, inner);
+    if (pos != last && *pos == inner) {
+        return values[pos - indices.data()];
+    }
+    return T();
+}
+
+template <typename T>
+SparseMatrix<T> SparseMatrix<T>::convert(SparseFormat f) const {
+    if (f == format) {
+        return *this;
+    }
+    // Counting sort of the entries by their inner index, which visits the
+    // old outer indices in order so the new inner indices come out sorted
+    const int newOuter = format == CSR ? col : row;
+    std::vector<int> newOffsets((std::size_t) newOuter + 1, 0);
+    for (int idx : indices) {
+        ++newOffsets[idx + 1];
+    }
+    for (int o = 0; o < newOuter; ++o) {
+        newOffsets[o + 1] += newOffsets[o];
+    }
+    std::vector<int> newIndices(indices.size());
+    std::vector<T> newValues(values.size());
+    std::vector<int> next(newOffsets.begin(), newOffsets.end() - 1);
+    for (int o = 0; o < outerSize(); ++o) {
+        for (int p = offsets[o]; p < offsets[o + 1]; ++p) {
+            const int dst = next[indices[p]]++;
+            newIndices[dst] = o;
+            newValues[dst] = values[p];
+        }
+    }
+    return SparseMatrix<T>(row, col, std::move(newOffsets),
+                           std::move(newIndices), std::move(newValues), f);
+}
+
+template <typename T>
+Matrix<T> SparseMatrix<T>::toDense() const {
+    Matrix<T> ret(row, col);
+    for (int o = 0; o < outerSize(); ++o) {
+        for (int p = offsets[o]; p < offsets[o + 1]; ++p) {
+            if (format == CSR) {
+                ret.rowData(o)[indices[p]] = values[p];
+            } else {
+                ret.rowData(indices[p])[o] = values[p];
+            }
+        }
+    }
+    return ret;
+}
+
+template <typename T>
+Matrix<T> SparseMatrix<T>::operator*(const Matrix<T> &m) const {
+    if (this->col != m.getRows()) {
+        throw IncompatibleMatrices('*', this->row, this->col, m.getRows(),
+                                   m.getCols());
+    }
+    Matrix<T> ret(this->row, m.getCols());
+    const int n = m.getCols();
+    // Every stored entry (i, k) adds a scaled row k of m to row i of the result
+    auto axpy = [&](int i, int k, const T &v) {
+        T *out = ret.rowData(i);
+        const T *in = m.rowData(k);
+        for (int j = 0; j < n; ++j) {
+            out[j] += v * in[j];
+        }
+    };
+    if (format == CSR) {
+        // Rows of the result are independent, so split them across threads
+        ThreadPool &pool = ThreadPool::instance();
+        const long work = (long) values.size() * n;
+        const int chunks = work < matrix_kernels::ParallelConfig::gemmCutoff()
+                           ? 1 : std::min(row, 4 * pool.getThreadCount());
+        pool.parallelFor(chunks, [&](int t) {
+            const int first = (int) ((long) row * t / chunks);
+            const int last = (int) ((long) row * (t + 1) / chunks);
+            for (int i = first; i < last; ++i) {
+                for (int p = offsets[i]; p < offsets[i + 1]; ++p) {
+                    axpy(i, indices[p], values[p]);
+                }
+            }
+        });
+    } else {
+        for (int k = 0; k < col; ++k) {
+            for (int p = offsets[k]; p < offsets[k + 1]; ++p) {
+                axpy(indices[p], k, values[p]);
+            }
+        }
+    }
+    return ret;
+}
+
+template <typename T>
+SparseMatrix<T> SparseMatrix<T>::operator*(const SparseMatrix<T> &m) const {
+    if (this->col != m.getRows()) {
+        throw IncompatibleMatrices('*', this->row, this->col, m.getRows(),
+                                   m.getCols());
+    }
+    const SparseMatrix<T> a = format == CSR ? *this : convert(CSR);
+    const SparseMatrix<T> b = m.getFormat() == CSR ? m : m.convert(CSR);
+    const int n = m.getCols();
+    std::vector<int> offs(1, 0);
+    std::vector<int> idx;
+    std::vector<T> vals;
+    // Dense accumulator for one result row plus the list of touched columns
+    std::vector<T> acc((std::size_t) n, T());
+    std::vector<int> seen((std::size_t) n, -1);
+    std::vector<int> touched;
+    for (int i = 0; i < row; ++i) {
+        touched.clear();
+        for (int p = a.offsets[i]; p < a.offsets[i + 1]; ++p) {
+            const int k = a.indices[p];
+            const T v = a.values[p];
+            for (int q = b.offsets[k]; q < b.offsets[k + 1]; ++q) {
+                const int j = b.indices[q];
+                if (seen[j] != i) {
+                    seen[j] = i;
+                    acc[j] = T();
+                    touched.push_back(j);
+                }
+                acc[j] += v * b.values[q];
+            }
+        }
+        std::sort(touched.begin(), touched.end());
+        for (int j : touched) {
+            idx.push_back(j);
+            vals.push_back(acc[j]);
+        }
+        offs.push_back((int) idx.size());
+    }
+    return SparseMatrix<T>(row, n, std::move(offs), std::move(idx),
+                           std::move(vals), CSR);
+}
+
+template <typename T>
+Matrix<T> SparseMatrix<T>::operator+(const Matrix<T> &m) const {
+    if (this->row != m.getRows() || this->col != m.getCols()) {
+        throw IncompatibleMatrices('+', this->row, this->col, m.getRows(),
+                                   m.getCols());
+    }
+    Matrix<T> ret = m;
+    for (int o = 0; o < outerSize(); ++o) {
+        for (int p = offsets[o]; p < offsets[o + 1]; ++p) {
+            if (format == CSR) {
+                ret.rowData(o)[indices[p]] += values[p];
+            } else {
+                ret.rowData(indices[p])[o] += values[p];
+            }
+        }
+    }
+    return ret;
+}
+
+template <typename T>
+bool SparseMatrix<T>::operator==(const SparseMatrix<T> &m) const {
+    if (this->row != m.getRows() || this->col != m.getCols()) {
+        return false;
+    }
+    const SparseMatrix<T> other = m.getFormat() == format ? m
+                                                          : m.convert(format);
+    // Merge each pair of outer indices, treating missing entries as zero
+    for (int o = 0; o < outerSize(); ++o) {
+        int p = offsets[o];
+        int q = other.offsets[o];
+        while (p < offsets[o + 1] || q < other.offsets[o + 1]) {
+            const int ip = p < offsets[o + 1] ? indices[p] : col + row;
+            const int iq = q < other.offsets[o + 1] ? other.indices[q]
+                                                    : col + row;
+            if (ip == iq) {
+                if (values[p++] != other.values[q++])
+                    return false;
+            } else if (ip < iq) {
+                if (values[p++] != T())
+                    return false;
+            } else {
+                if (other.values[q++] != T())
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <typename T>
+bool SparseMatrix<T>::operator==(const Matrix<T> &m) const {
+    if (this->row != m.getRows() || this->col != m.getCols()) {
+        return false;
+    }
+    const SparseMatrix<T> csr = format == CSR ? *this : convert(CSR);
+    for (int i = 0; i < row; ++i) {
+        const T *in = m.rowData(i);
+        int p = csr.offsets[i];
+        for (int j = 0; j < col; ++j) {
+            T v = T();
+            if (p < csr.offsets[i + 1] && csr.indices[p] == j) {
+                v = csr.values[p++];
+            }
+            if (v != in[j])
+                return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+bool SparseMatrix<T>::operator!=(const SparseMatrix<T> &m) const {
+    return !(*this == m);
+}
+
+template <typename T>
+bool SparseMatrix<T>::operator!=(const Matrix<T> &m) const {
+    return !(*this == m);
+}
+
+/**
+ * @brief Overloading the multiplication operator for a dense Matrix times a
+ *        SparseMatrix. Every stored entry (k, j) of the sparse operand adds
+ *        a scaled column k of the dense operand to column j of the result
+ *
+ * @param l : the dense matrix
+ * @param r : the sparse matrix to be multiplied to l
+ * @return the (dense) product of l and r
+ */
+template <typename T>
+Matrix<T> operator*(const Matrix<T> &l, const SparseMatrix<T> &r) {
+    if (l.getCols() != r.getRows()) {
+        throw IncompatibleMatrices('*', l.getRows(), l.getCols(), r.getRows(),
+                                   r.getCols());
+    }
+    const SparseMatrix<T> csr = r.getFormat() == CSR ? r : r.convert(CSR);
+    const std::vector<int> &offs = csr.getOffsets();
+    const std::vector<int> &idx = csr.getIndices();
+    const std::vector<T> &vals = csr.getValues();
+    Matrix<T> ret(l.getRows(), r.getCols());
+    for (int i = 0; i < l.getRows(); ++i) {
+        const T *in = l.rowData(i);
+        T *out = ret.rowData(i);
+        for (int k = 0; k < l.getCols(); ++k) {
+            const T a = in[k];
+            for (int p = offs[k]; p < offs[k + 1]; ++p) {
+                out[idx[p]] += a * vals[p];
+            }
+        }
+    }
+    return ret;
+}
+
+/**
+ * @brief Overloading the addition operator for a dense Matrix plus a
+ *        SparseMatrix
+ *
+ * @param l : the dense matrix
+ * @param r : the sparse matrix to be added to l
+ * @return the (dense) sum of l and r
+ */
+template <typename T>
+Matrix<T> operator+(const Matrix<T> &l, const SparseMatrix<T> &r) {
+    return r + l;
+}
+
+template <typename T>
+bool operator==(const Matrix<T> &l, const SparseMatrix<T> &r) {
+    return r == l;
+}
+
+template <typename T>
+bool operator!=(const Matrix<T> &l, const SparseMatrix<T> &r) {
+    return r != l;
+}
+
+#endif
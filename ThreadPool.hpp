@@ -0,0 +1,301 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      ThreadPool.hpp
+//
+// Author:         Sahib Pandori and Haylee Monteiro
+// CS email:       sahib@cs.wisc.edu and haylee@cs.wisc.edu
+//
+// Description:    This file contains the persistent work-stealing thread pool
+//                 shared by the parallel Matrix kernels
+///////////////////////////////////////////////////////////////////////////////
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Pool of worker threads, each owning a deque of tasks. A worker pops
+ *        from the back of its own deque and, when that runs dry, steals from
+ *        the front of the others. Threads are started lazily on the first
+ *        parallel call and live until the program exits
+ */
+class ThreadPool {
+private:
+    // One parallelFor() call; tasks point back at it to report completion
+    struct Job {
+        const std::function<void(int)> *body;
+        std::atomic<int> remaining;
+        std::mutex lock;
+        std::exception_ptr error;
+    };
+
+    // A single index of a parallelFor() call
+    struct Task {
+        Job *job;
+        int index;
+    };
+
+    // Task deque owned by one worker: tasks[head, end) are queued. It is a
+    // vector that is reset whenever it drains, so once it has grown to the
+    // largest call it never touches the heap again
+    struct Queue {
+        std::mutex lock;
+        std::vector<Task> tasks;
+        std::size_t head;
+
+        Queue() : head(0) {}
+
+        bool empty() const {
+            return head == tasks.size();
+        }
+
+        Task popBack() {
+            Task t = tasks.back();
+            tasks.pop_back();
+            reset();
+            return t;
+        }
+
+        Task popFront() {
+            Task t = tasks[head++];
+            reset();
+            return t;
+        }
+
+        void reset() {
+            if (empty()) {
+                tasks.clear();
+                head = 0;
+            }
+        }
+    };
+
+    // Requested number of threads, including the calling thread
+    int threads;
+    // Worker threads (threads - 1 of them once started)
+    std::vector<std::thread> workers;
+    // One queue per worker
+    std::vector<std::unique_ptr<Queue>> queues;
+    // Number of queued tasks not yet picked up by anyone
+    std::atomic<long> pending;
+    // Set when the workers should exit
+    std::atomic<bool> stopping;
+    // Serializes starting and stopping the workers
+    std::mutex control;
+    // Idle workers sleep on this until tasks are queued
+    std::mutex sleepLock;
+    std::condition_variable wake;
+
+    ThreadPool() : pending(0), stopping(false) {
+        unsigned hw = std::thread::hardware_concurrency();
+        threads = hw == 0 ? 1 : (int) hw;
+    }
+
+    ~ThreadPool() {
+        stop();
+    }
+
+    /**
+     * @brief Starts the worker threads if they are not running yet
+     */
+    void start() {
+        std::lock_guard<std::mutex> guard(control);
+        if (!workers.empty() || threads <= 1) {
+            return;
+        }
+        stopping = false;
+        for (int i = 0; i < threads - 1; ++i) {
+            queues.emplace_back(new Queue());
+        }
+        for (int i = 0; i < threads - 1; ++i) {
+            workers.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    /**
+     * @brief Stops and joins every worker thread
+     */
+    void stop() {
+        std::lock_guard<std::mutex> guard(control);
+        {
+            std::lock_guard<std::mutex> sleeping(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &t : workers) {
+            t.join();
+        }
+        workers.clear();
+        queues.clear();
+    }
+
+    /**
+     * @brief Takes a task, preferring the back of queue `self` and otherwise
+     *        stealing from the front of the other queues
+     *
+     * @param self : index of the caller's own queue, or -1 for a thread that
+     *               does not own one
+     * @param out : receives the task
+     * @return true if a task was found
+     */
+    bool take(int self, Task &out) {
+        const int n = (int) queues.size();
+        if (self >= 0) {
+            Queue &own = *queues[self];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.empty()) {
+                out = own.popBack();
+                --pending;
+                return true;
+            }
+        }
+        for (int i = 1; i <= n; ++i) {
+            Queue &victim = *queues[(self + i + n) % n];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.empty()) {
+                out = victim.popFront();
+                --pending;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Runs a task and records its completion (or failure) on its job
+     */
+    static void run(const Task &task) {
+        Job &job = *task.job;
+        try {
+            (*job.body)(task.index);
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(job.lock);
+            if (!job.error) {
+                job.error = std::current_exception();
+            }
+        }
+        --job.remaining;
+    }
+
+    void workerLoop(int self) {
+        Task task;
+        while (true) {
+            if (take(self, task)) {
+                run(task);
+                continue;
+            }
+            std::unique_lock<std::mutex> sleeping(sleepLock);
+            wake.wait(sleeping, [this] { return stopping || pending > 0; });
+            if (stopping) {
+                return;
+            }
+        }
+    }
+
+public:
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * @brief Returns the pool shared by the whole library
+     *
+     * @return reference to the pool
+     */
+    static ThreadPool &instance() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    /**
+     * @brief Returns the number of threads parallel calls are spread across,
+     *        including the calling thread
+     *
+     * @return number of threads
+     */
+    int getThreadCount() const {
+        return threads;
+    }
+
+    /**
+     * @brief Sets the number of threads parallel calls are spread across,
+     *        including the calling thread. Running workers are restarted, so
+     *        this must not be called while a parallel call is in flight
+     *
+     * @param n : number of threads, 1 (or less) runs everything serially
+     */
+    void setThreadCount(int n) {
+        stop();
+        threads = n < 1 ? 1 : n;
+    }
+
+    /**
+     * @brief Runs body(i) for every i in [0, count) and returns once all of
+     *        them have finished. The calling thread works on the tasks too,
+     *        so nested calls cannot deadlock. If any task throws, the first
+     *        exception is rethrown here after all tasks have finished
+     *
+     * @param count : number of tasks
+     * @param body : function called with the index of each task
+     */
+    void parallelFor(int count, const std::function<void(int)> &body) {
+        if (count <= 0) {
+            return;
+        }
+        start();
+        if (count == 1 || workers.empty()) {
+            for (int i = 0; i < count; ++i) {
+                body(i);
+            }
+            return;
+        }
+        Job job;
+        job.body = &body;
+        job.remaining = count;
+        // Deal the tasks out round-robin so every worker starts with a share
+        const int n = (int) queues.size();
+        for (int i = 0; i < count; ++i) {
+            Queue &q = *queues[i % n];
+            std::lock_guard<std::mutex> guard(q.lock);
+            q.tasks.push_back(Task{&job, i});
+            ++pending;
+        }
+        {
+            std::lock_guard<std::mutex> sleeping(sleepLock);
+        }
+        wake.notify_all();
+
+        Task task;
+        while (job.remaining > 0) {
+            if (take(-1, task)) {
+                run(task);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        if (job.error) {
+            std::rethrow_exception(job.error);
+        }
+    }
+
+    /**
+     * @brief Same as above for any callable. The callable is wrapped by
+     *        reference, so the call does not allocate a std::function for
+     *        large lambdas
+     *
+     * @param count : number of tasks
+     * @param body : function called with the index of each task
+     */
+    template <typename F>
+    void parallelFor(int count, const F &body) {
+        parallelFor(count, std::function<void(int)>(std::cref(body)));
+    }
+};
+
+#endif
@@ -0,0 +1,28 @@
+#!/bin/bash
+
+# Builds benchmark.cpp with optimizations and runs it, writing the JSON report
+# to bench_output.txt. Arguments are passed through to the benchmark, e.g.
+# ./bench.sh --max-size=1024 --types=double --ops=multiply
+# Set CXXFLAGS to benchmark another configuration (e.g. -DMATRIX_NO_SIMD)
+
+# Constants
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+OUTPUT="$DIR/bench_output.txt"
+
+cd $DIR
+
+# Exit if code does not compile
+g++ -std=c++11 -O3 -march=native -DNDEBUG $CXXFLAGS -pthread ./benchmark.cpp -o ./bench
+status=$?
+if ((status != 0)); then
+    (<&2 echo "Could not compile benchmark, exiting")
+    exit $status
+fi
+
+./bench --json="$OUTPUT" "$@"
+status=$?
+rm -rf ./bench
+if ((status != 0)); then
+    exit $status
+fi
+echo "Wrote results to $OUTPUT"
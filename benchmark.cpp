@@ -0,0 +1,503 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      benchmark.cpp
+//
+// Author:         Sahib Pandori and Haylee Monteiro
+// CS email:       sahib@cs.wisc.edu and haylee@cs.wisc.edu
+//
+// Description:    Benchmarks for every Matrix operator across sizes and
+//                 element types. Reports time, GFLOP/s, GB/s and heap
+//                 allocations per operation as JSON. Build and run it through
+//                 bench.sh
+///////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <streambuf>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Matrix.hpp"
+#include "MatrixLU.hpp"
+
+// Number of calls to the global operator new since the program started
+static std::atomic<long> allocationCount(0);
+
+// Keeps GCC from inlining the replacements below and then warning that
+// memory from operator new is released with free()
+#ifdef __GNUC__
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+BENCH_NOINLINE void *operator new(std::size_t size) {
+    ++allocationCount;
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+BENCH_NOINLINE void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+BENCH_NOINLINE void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+/**
+ * @brief Stream buffer that throws its output away but counts the bytes, so
+ *        operator<< can be timed without measuring a terminal or a disk
+ */
+class CountingBuffer : public std::streambuf {
+private:
+    char buffer[4096];
+    long long written;
+protected:
+    virtual int overflow(int c) override {
+        written += pptr() - pbase();
+        setp(buffer, buffer + sizeof(buffer));
+        if (c != traits_type::eof()) {
+            *pptr() = (char) c;
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    virtual int sync() override {
+        written += pptr() - pbase();
+        setp(buffer, buffer + sizeof(buffer));
+        return 0;
+    }
+public:
+    CountingBuffer() : written(0) {
+        setp(buffer, buffer + sizeof(buffer));
+    }
+
+    long long bytes() {
+        sync();
+        return written;
+    }
+};
+
+// Names and flop counts per element type
+template <typename T>
+struct TypeInfo {
+    static const char *name();
+    // Flops in one addition and in one multiplication of two elements
+    static const int addFlops = 1;
+    static const int mulFlops = 1;
+    // Whether multiply3M differs from operator*
+    static const bool complex = false;
+    static T value(int i) {
+        return T(i % 7 - 3);
+    }
+};
+
+template <> const char *TypeInfo<int>::name() { return "int"; }
+template <> const char *TypeInfo<float>::name() { return "float"; }
+template <> const char *TypeInfo<double>::name() { return "double"; }
+
+template <typename R>
+struct TypeInfo<std::complex<R>> {
+    static const char *name();
+    static const int addFlops = 2;
+    static const int mulFlops = 6;
+    static const bool complex = true;
+    static std::complex<R> value(int i) {
+        return std::complex<R>(R(i % 7 - 3), R(i % 5 - 2));
+    }
+};
+
+template <> const char *TypeInfo<std::complex<int>>::name() {
+    return "complex<int>";
+}
+template <> const char *TypeInfo<std::complex<double>>::name() {
+    return "complex<double>";
+}
+
+/**
+ * @brief Command line options
+ */
+struct Options {
+    // Largest size benchmarked for the element-wise operators
+    int maxSize = 8192;
+    // Largest size benchmarked for matrix multiplication
+    int maxMultiplySize = 2048;
+    // Minimum time spent repeating each benchmark, in seconds
+    double minTime = 0.2;
+    // Comma separated operators / types to run, all of them if empty
+    std::string opFilter;
+    std::string typeFilter;
+    // Where to write the JSON report, stdout if empty
+    std::string jsonPath;
+};
+
+/**
+ * @brief One line of the report
+ */
+struct Result {
+    std::string op;
+    std::string type;
+    int size;
+    long iterations;
+    double seconds;
+    double flops;
+    double bytes;
+    long allocations;
+};
+
+// Keeps results observable so the compiler cannot drop the benchmarked work
+static long long sink = 0;
+
+template <typename T>
+void consume(const T &v) {
+    sink += v == T() ? 1 : 2;
+}
+
+/**
+ * @brief Repeats body until minTime has passed and records the average
+ */
+template <typename F>
+Result measure(const Options &opt, const std::string &op,
+               const std::string &type, int n, double flopsPerOp,
+               double bytesPerOp, F body) {
+    typedef std::chrono::steady_clock Clock;
+    body();  // warm up caches, the thread pool and scratch buffers
+    long iterations = 0;
+    const long allocsBefore = allocationCount;
+    const Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    do {
+        body();
+        ++iterations;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < opt.minTime && iterations < 1000000);
+    Result r;
+    r.op = op;
+    r.type = type;
+    r.size = n;
+    r.iterations = iterations;
+    r.seconds = elapsed / iterations;
+    r.flops = flopsPerOp;
+    r.bytes = bytesPerOp;
+    r.allocations = (allocationCount - allocsBefore) / iterations;
+    return r;
+}
+
+template <typename T>
+Matrix<T> filled(int n, int seed) {
+    Matrix<T> m(n, n);
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            m[i][j] = TypeInfo<T>::value(i * 31 + j * 17 + seed);
+        }
+    }
+    return m;
+}
+
+// True if filter is empty or name is one of its comma separated entries
+bool selected(const std::string &filter, const std::string &name) {
+    return filter.empty()
+           || ("," + filter + ",").find("," + name + ",") != std::string::npos;
+}
+
+// LU factorization of a, for the element types that have one
+template <typename T>
+void benchmarkLU(const Options &opt, std::vector<Result> &out,
+                 const Matrix<T> &a, std::true_type) {
+    typedef TypeInfo<T> Info;
+    const int n = a.getRows();
+    // A dominant diagonal keeps the pivots away from zero
+    Matrix<T> m = a;
+    for (int i = 0; i < n; ++i) {
+        m[i][i] += T(n);
+    }
+    const double flops = (double) n * n * n / 3
+                         * (Info::mulFlops + Info::addFlops);
+    const double bytes = (double) n * n * sizeof(T);
+    out.push_back(measure(opt, "lu_factor", Info::name(), n, flops,
+                          2 * bytes, [&] {
+        LUDecomposition<T> lu(m);
+        consume(lu.getFactors().rowData(0)[0]);
+    }));
+}
+
+template <typename T>
+void benchmarkLU(const Options &, std::vector<Result> &, const Matrix<T> &,
+                 std::false_type) {}
+
+template <typename T>
+void benchmarkType(const Options &opt, std::vector<Result> &out) {
+    typedef TypeInfo<T> Info;
+    const std::string type = Info::name();
+    if (!selected(opt.typeFilter, type)) {
+        return;
+    }
+    for (int n = 2; n <= opt.maxSize; n *= 2) {
+        const double elems = (double) n * n;
+        const double bytes = elems * sizeof(T);
+        Matrix<T> a = filled<T>(n, 1);
+        Matrix<T> b = filled<T>(n, 2);
+        Matrix<T> c(n, n);
+        const T scalar = Info::value(5);
+        std::cerr << "benchmarking " << type << " " << n << "x" << n
+                  << std::endl;
+
+        if (selected(opt.opFilter, "construct")) {
+            out.push_back(measure(opt, "construct", type, n, 0, bytes, [&] {
+                Matrix<T> m(n, n);
+                consume(m.rowData(0)[0]);
+            }));
+        }
+        if (selected(opt.opFilter, "index")) {
+            out.push_back(measure(opt, "index", type, n, 0, bytes, [&] {
+                T sum = T();
+                for (int i = 0; i < n; ++i) {
+                    for (int j = 0; j < n; ++j) {
+                        sum += a[i][j];
+                    }
+                }
+                consume(sum);
+            }));
+        }
+        if (selected(opt.opFilter, "element")) {
+            out.push_back(measure(opt, "element", type, n, 0, bytes, [&] {
+                T sum = T();
+                for (int i = 0; i < n; ++i) {
+                    for (int j = 0; j < n; ++j) {
+                        sum += a(i, j);
+                    }
+                }
+                consume(sum);
+            }));
+        }
+        if (selected(opt.opFilter, "add")) {
+            out.push_back(measure(opt, "add", type, n, elems * Info::addFlops,
+                                  3 * bytes, [&] {
+                c = a + b;
+                consume(c.rowData(0)[0]);
+            }));
+        }
+        if (selected(opt.opFilter, "subtract")) {
+            out.push_back(measure(opt, "subtract", type, n,
+                                  elems * Info::addFlops, 3 * bytes, [&] {
+                c = a - b;
+                consume(c.rowData(0)[0]);
+            }));
+        }
+        if (selected(opt.opFilter, "scalar_multiply")) {
+            out.push_back(measure(opt, "scalar_multiply", type, n,
+                                  elems * Info::mulFlops, 2 * bytes, [&] {
+                c = a * scalar;
+                consume(c.rowData(0)[0]);
+            }));
+        }
+        if (selected(opt.opFilter, "compound_add")) {
+            out.push_back(measure(opt, "compound_add", type, n,
+                                  elems * Info::addFlops, 3 * bytes, [&] {
+                c += b;
+                consume(c.rowData(0)[0]);
+            }));
+        }
+        if (selected(opt.opFilter, "compound_subtract")) {
+            out.push_back(measure(opt, "compound_subtract", type, n,
+                                  elems * Info::addFlops, 3 * bytes, [&] {
+                c -= b;
+                consume(c.rowData(0)[0]);
+            }));
+        }
+        if (selected(opt.opFilter, "compound_scalar_multiply")) {
+            const T one = T(1);
+            out.push_back(measure(opt, "compound_scalar_multiply", type, n,
+                                  elems * Info::mulFlops, 2 * bytes, [&] {
+                c *= one;
+                consume(c.rowData(0)[0]);
+            }));
+        }
+        if (selected(opt.opFilter, "equal")) {
+            Matrix<T> copy = a;
+            out.push_back(measure(opt, "equal", type, n, elems, 2 * bytes,
+                                  [&] {
+                sink += a == copy;
+            }));
+        }
+        if (selected(opt.opFilter, "transpose")) {
+            out.push_back(measure(opt, "transpose", type, n, 0, 2 * bytes,
+                                  [&] {
+                c = a.t();
+                consume(c.rowData(0)[0]);
+            }));
+        }
+        if (selected(opt.opFilter, "vector_multiply")
+            || selected(opt.opFilter, "transpose_vector_multiply")) {
+            std::vector<T> x((std::size_t) n), y((std::size_t) n);
+            for (int i = 0; i < n; ++i) {
+                x[i] = Info::value(i);
+            }
+            const double flops = (double) n * n
+                                 * (Info::mulFlops + Info::addFlops);
+            if (selected(opt.opFilter, "vector_multiply")) {
+                out.push_back(measure(opt, "vector_multiply", type, n, flops,
+                                      bytes, [&] {
+                    multiplyVector(a, x.data(), y.data());
+                    consume(y[0]);
+                }));
+            }
+            if (selected(opt.opFilter, "transpose_vector_multiply")) {
+                out.push_back(measure(opt, "transpose_vector_multiply", type,
+                                      n, flops, bytes, [&] {
+                    multiplyVector(a, x.data(), y.data(), true);
+                    consume(y[0]);
+                }));
+            }
+        }
+        if (selected(opt.opFilter, "print") && n <= 2048) {
+            CountingBuffer counter;
+            std::ostream o(&counter);
+            o << a;
+            const double text = (double) counter.bytes();
+            out.push_back(measure(opt, "print", type, n, 0, text, [&] {
+                o << a;
+                o.flush();
+            }));
+        }
+        if (n <= opt.maxMultiplySize) {
+            const double flops = (double) n * n * n
+                                 * (Info::mulFlops + Info::addFlops);
+            if (selected(opt.opFilter, "multiply")) {
+                out.push_back(measure(opt, "multiply", type, n, flops,
+                                      3 * bytes, [&] {
+                    c = a * b;
+                    consume(c.rowData(0)[0]);
+                }));
+            }
+            if (Info::complex && selected(opt.opFilter, "multiply_3m")) {
+                out.push_back(measure(opt, "multiply_3m", type, n, flops,
+                                      3 * bytes, [&] {
+                    c = a.multiply3M(b);
+                    consume(c.rowData(0)[0]);
+                }));
+            }
+            if (selected(opt.opFilter, "batched_multiply") && n <= 32) {
+                // One call multiplies a batch of small independent products
+                const int count = 4096;
+                std::vector<Matrix<T>> as(count, a), bs(count, b), cs(count, c);
+                out.push_back(measure(opt, "batched_multiply", type, n,
+                                      count * flops, 3 * count * bytes, [&] {
+                    multiplyBatched(as.data(), bs.data(), cs.data(), count);
+                    consume(cs[0].rowData(0)[0]);
+                }));
+            }
+            if (selected(opt.opFilter, "transpose_multiply")) {
+                out.push_back(measure(opt, "transpose_multiply", type, n,
+                                      flops, 3 * bytes, [&] {
+                    c = a.t() * b;
+                    consume(c.rowData(0)[0]);
+                }));
+            }
+            if (selected(opt.opFilter, "power")) {
+                // 100 = 0b1100100: six squarings and two more products
+                out.push_back(measure(opt, "power", type, n, 8 * flops,
+                                      3 * bytes, [&] {
+                    c = pow(a, 100);
+                    consume(c.rowData(0)[0]);
+                }));
+            }
+            if (selected(opt.opFilter, "lu_factor")) {
+                benchmarkLU(opt, out, a, std::integral_constant<bool,
+                            matrix_kernels::IsFieldType<T>::value>());
+            }
+            if (selected(opt.opFilter, "compound_multiply")) {
+                // Multiplying by the identity keeps the values from
+                // overflowing however many iterations run
+                Matrix<T> d = a;
+                Matrix<T> identity(n, n);
+                for (int i = 0; i < n; ++i) {
+                    identity[i][i] = T(1);
+                }
+                out.push_back(measure(opt, "compound_multiply", type, n,
+                                      flops, 3 * bytes, [&] {
+                    d *= identity;
+                    consume(d.rowData(0)[0]);
+                }));
+            }
+        }
+    }
+}
+
+void writeJson(std::ostream &o, const std::vector<Result> &results) {
+    o << "{\n  \"threads\": " << getMatrixThreads() << ",\n"
+      << "  \"benchmarks\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        o << "    {\"op\": \"" << r.op << "\", \"type\": \"" << r.type
+          << "\", \"rows\": " << r.size << ", \"cols\": " << r.size
+          << ", \"iterations\": " << r.iterations
+          << ", \"seconds_per_op\": " << r.seconds
+          << ", \"gflops\": " << r.flops / r.seconds / 1e9
+          << ", \"gbps\": " << r.bytes / r.seconds / 1e9
+          << ", \"allocations_per_op\": " << r.allocations << "}"
+          << (i + 1 == results.size() ? "\n" : ",\n");
+    }
+    o << "  ]\n}\n";
+}
+
+/**
+ * @brief Benchmark execution begins here.
+ *
+ * Options: --max-size=N, --max-multiply-size=N, --min-time=SECONDS,
+ *          --threads=N, --ops=a,b,... --types=a,b,... --json=PATH
+ *
+ * @return 0 for normal program termination, 1 for bad arguments
+ */
+int main(int argc, char **argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string::size_type eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        if (key == "--max-size") {
+            opt.maxSize = std::atoi(value.c_str());
+        } else if (key == "--max-multiply-size") {
+            opt.maxMultiplySize = std::atoi(value.c_str());
+        } else if (key == "--min-time") {
+            opt.minTime = std::atof(value.c_str());
+        } else if (key == "--threads") {
+            setMatrixThreads(std::atoi(value.c_str()));
+        } else if (key == "--ops") {
+            opt.opFilter = value;
+        } else if (key == "--types") {
+            opt.typeFilter = value;
+        } else if (key == "--json") {
+            opt.jsonPath = value;
+        } else {
+            std::cerr << "Argument \"" << arg << "\" is invalid" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<Result> results;
+    benchmarkType<int>(opt, results);
+    benchmarkType<float>(opt, results);
+    benchmarkType<double>(opt, results);
+    benchmarkType<std::complex<int>>(opt, results);
+    benchmarkType<std::complex<double>>(opt, results);
+
+    if (opt.jsonPath.empty()) {
+        writeJson(std::cout, results);
+    } else {
+        std::ofstream file(opt.jsonPath.c_str());
+        writeJson(file, results);
+    }
+    return sink == -1 ? 1 : 0;
+}
@@ -16,11 +16,18 @@
 //                 http://en.cppreference.com/w/
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <clocale>
+#include <cstdio>
 #include <fstream>
 #include <type_traits>
 #include <complex>
 #include "gtest/gtest.h"
 #include "Matrix.hpp"
+#include "SparseMatrix.hpp"
+#include "FixedMatrix.hpp"
+#include "MatrixIO.hpp"
+#include "MatrixPool.hpp"
+#include "MatrixLU.hpp"
 
 /**
  * @brief Empties the contents of the buffer, and clears its error state flags.
@@ -146,6 +153,45 @@ typedef Matrix IntegerMatrix;
 typedef Matrix<int> IntegerMatrix;
 #endif
 
+/**
+ * @brief Returns a rows x cols matrix of small integers, exact in every
+ *        element type, that differs from seed to seed.
+ */
+template <typename T>
+Matrix<T> patterned(int rows, int cols, int seed) {
+    Matrix<T> m(rows, cols);
+    for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < cols; ++j) {
+            m[i][j] = T((i * 7 + j * 3 + seed * 5) % 11 - 5);
+        }
+    }
+    return m;
+}
+
+/**
+ * @brief The blocked product, for expectProductMatchesReference
+ */
+struct BlockedProduct {
+    template <typename T>
+    Matrix<T> operator()(const Matrix<T> &a, const Matrix<T> &b) const {
+        return a * b;
+    }
+};
+
+/**
+ * @brief Checks product(a, b) for patterned m x k and k x n matrices against
+ *        the reference triple loop. The entries are small integers, so the
+ *        floating point results are exact too.
+ */
+template <typename T, typename Product>
+void expectProductMatchesReference(int m, int n, int k,
+                                   const Product &product) {
+    const Matrix<T> a = patterned<T>(m, k, 1);
+    const Matrix<T> b = patterned<T>(k, n, 2);
+    EXPECT_TRUE(product(a, b) == a.multiplyReference(b))
+        << m << " x " << k << " times " << k << " x " << n;
+}
+
 #ifdef RunBasicMatrixTest
 
 /**
@@ -420,8 +466,8 @@ TEST_F(A4Test, BasicAdditionTest) {
 #ifdef RunConstAdditionTest
 
 /**
- * @brief Test case to make sure the + operator return type is const. This test
- *        should fail to compile.
+ * @brief Test case to make sure the result of the + operator cannot be assigned
+ *        to. This test should fail to compile.
  */
 TEST_F(A4Test, ConstAdditionTest) {
     IntegerMatrix m(2, 2);
@@ -667,6 +713,14 @@ TEST_F(A4Test, BasicCompoundMatrixMultiplicationTest) {
     EXPECT_EQ(m[1][0], 37);
     EXPECT_EQ(m[1][1], 11);
 
+    // Repeated *= of a square matrix alternates between two buffers
+    const int *storage = m.rowData(0);
+    m *= n;
+    m *= n;
+    EXPECT_EQ(m.rowData(0), storage);
+    EXPECT_EQ(m[0][0], 447);
+    EXPECT_EQ(m[1][1], 306);
+
     MATCH_END(buff);
     clearBuff(buff);
 }
@@ -798,6 +852,1120 @@ TEST_F(A4Test, ComplexTest) {
 
 #endif
 
+#ifdef RunGemmKernelTest
+
+/**
+ * @brief Test case to make sure the packed, blocked kernel handles sizes that
+ *        are not multiples of its register and cache blocks.
+ */
+TEST_F(A4Test, GemmKernelTest) {
+    expectProductMatchesReference<int>(67, 91, 45, BlockedProduct());
+    expectProductMatchesReference<int>(129, 130, 257, BlockedProduct());
+    expectProductMatchesReference<float>(67, 91, 45, BlockedProduct());
+    expectProductMatchesReference<float>(129, 130, 257, BlockedProduct());
+    expectProductMatchesReference<double>(67, 91, 45, BlockedProduct());
+    expectProductMatchesReference<double>(129, 130, 257, BlockedProduct());
+}
+
+#endif
+
+#ifdef RunSimdTailTest
+
+/**
+ * @brief Checks sums, differences, scaling, comparison and matrix-vector
+ *        products element by element for every width from 1 to 19, so each
+ *        vector width is exercised with every possible leftover tail.
+ */
+template <typename T>
+void expectElementwiseTails() {
+    for (int cols = 1; cols < 20; ++cols) {
+        Matrix<T> a = patterned<T>(3, cols, 1);
+        Matrix<T> b = patterned<T>(3, cols, 2);
+        Matrix<T> sum = a + b;
+        Matrix<T> difference = a - b;
+        Matrix<T> scaled = a * T(3);
+        std::vector<T> x(cols);
+        for (int j = 0; j < cols; ++j) {
+            x[j] = T(j % 5 - 2);
+        }
+        std::vector<T> y = a * x;
+        for (int i = 0; i < 3; ++i) {
+            T dot = T();
+            for (int j = 0; j < cols; ++j) {
+                EXPECT_EQ(sum[i][j], a[i][j] + b[i][j]) << cols;
+                EXPECT_EQ(difference[i][j], a[i][j] - b[i][j]) << cols;
+                EXPECT_EQ(scaled[i][j], a[i][j] * T(3)) << cols;
+                dot += a[i][j] * x[j];
+            }
+            EXPECT_EQ(y[i], dot) << cols;
+        }
+
+        // A difference confined to the last column lands in the scalar tail
+        Matrix<T> c(a);
+        EXPECT_TRUE(c == a);
+        c[2][cols - 1] += T(1);
+        EXPECT_FALSE(c == a) << cols;
+        EXPECT_TRUE(c != a) << cols;
+    }
+}
+
+/**
+ * @brief Test case to make sure the vectorized kernels handle widths that are
+ *        not multiples of the vector width.
+ */
+TEST_F(A4Test, SimdTailTest) {
+    expectElementwiseTails<int>();
+    expectElementwiseTails<float>();
+    expectElementwiseTails<double>();
+}
+
+#endif
+
+#ifdef RunParallelGemmTest
+
+/**
+ * @brief a * b with a, b or both stored transposed and read back through t(),
+ *        for expectProductMatchesReference
+ */
+struct TransposedProduct {
+    bool transA;
+    bool transB;
+
+    TransposedProduct(bool ta, bool tb) : transA(ta), transB(tb) {}
+
+    template <typename T>
+    Matrix<T> operator()(const Matrix<T> &a, const Matrix<T> &b) const {
+        const Matrix<T> at = a.transpose();
+        const Matrix<T> bt = b.transpose();
+        if (transA && transB) {
+            return at.t() * bt.t();
+        }
+        return transA ? at.t() * b : a * bt.t();
+    }
+};
+
+/**
+ * @brief The product computed by *=, for expectProductMatchesReference
+ */
+struct CompoundProduct {
+    template <typename T>
+    Matrix<T> operator()(const Matrix<T> &a, const Matrix<T> &b) const {
+        Matrix<T> product(a);
+        product *= b;
+        return product;
+    }
+};
+
+/**
+ * @brief Test case to make sure the tiled parallel product matches the
+ *        reference for ragged, non-square shapes, with and without
+ *        transposed operands.
+ */
+TEST_F(A4Test, ParallelGemmTest) {
+    const int threads = getMatrixThreads();
+    const long cutoff = getMatrixParallelCutoff();
+    setMatrixThreads(4);
+    setMatrixParallelCutoff(1);
+
+    const int shapes[][3] = {{1, 1, 1}, {5, 3, 7}, {67, 91, 45},
+                             {130, 33, 257}, {29, 150, 64}};
+    for (const int *shape : shapes) {
+        const int m = shape[0], n = shape[1], k = shape[2];
+        expectProductMatchesReference<double>(m, n, k, BlockedProduct());
+        expectProductMatchesReference<double>(m, n, k,
+                                              TransposedProduct(true, false));
+        expectProductMatchesReference<double>(m, n, k,
+                                              TransposedProduct(false, true));
+        expectProductMatchesReference<double>(m, n, k,
+                                              TransposedProduct(true, true));
+        expectProductMatchesReference<int>(m, n, k, CompoundProduct());
+    }
+
+    setMatrixThreads(threads);
+    setMatrixParallelCutoff(cutoff);
+}
+
+#endif
+
+#ifdef RunFusedExpressionTest
+
+/**
+ * @brief Test case to make sure a chained expression is evaluated in one pass
+ *        with the right values, and that assignments which read their own
+ *        target out of place fall back to a temporary.
+ */
+TEST_F(A4Test, FusedExpressionTest) {
+    Matrix<double> a = patterned<double>(37, 53, 1);
+    Matrix<double> b = patterned<double>(37, 53, 2);
+    Matrix<double> c = patterned<double>(37, 53, 3);
+    Matrix<double> r = a + b * 2.5 - c;
+    for (int i = 0; i < 37; ++i) {
+        for (int j = 0; j < 53; ++j) {
+            EXPECT_EQ(r[i][j], a[i][j] + b[i][j] * 2.5 - c[i][j]);
+        }
+    }
+    // Reading the target element by element in place is safe
+    a = a + b * 2.5 - c;
+    EXPECT_TRUE(a == r);
+
+    IntegerMatrix s = patterned<int>(5, 5, 4);
+    IntegerMatrix expected = s.transpose();
+    s = s.t();
+    EXPECT_TRUE(s == expected);
+    expected = s + s.transpose();
+    s = s + s.t();
+    EXPECT_TRUE(s == expected);
+
+    // Rows of writable views take the same vectorized kernels as matrices
+    IntegerMatrix x = patterned<int>(6, 9, 6);
+    IntegerMatrix y = patterned<int>(6, 9, 7);
+    auto xv = x.view(0, 0, 6, 9);
+    auto yv = y.view(0, 0, 6, 9);
+    EXPECT_TRUE(IntegerMatrix(xv + yv) == IntegerMatrix(x + y));
+    EXPECT_TRUE(IntegerMatrix(xv * 3) == IntegerMatrix(x * 3));
+    EXPECT_TRUE(xv == x);
+    EXPECT_FALSE(xv == yv);
+
+    // Overlapping blocks of the same matrix, shifted by a column and a row
+    IntegerMatrix m = patterned<int>(6, 8, 5);
+    IntegerMatrix copy(m);
+    m.view(0, 1, 6, 7) = m.view(0, 0, 6, 7) * 2 + copy.view(0, 0, 6, 7);
+    m.view(1, 0, 5, 8) += m.view(0, 0, 5, 8);
+    IntegerMatrix shifted(copy);
+    for (int i = 0; i < 6; ++i) {
+        for (int j = 1; j < 8; ++j) {
+            shifted[i][j] = copy[i][j - 1] * 3;
+        }
+    }
+    // Bottom up, so every row adds the old value of the row above
+    for (int i = 5; i > 0; --i) {
+        for (int j = 0; j < 8; ++j) {
+            shifted[i][j] += shifted[i - 1][j];
+        }
+    }
+    EXPECT_TRUE(m == shifted);
+}
+
+#endif
+
+#ifdef RunMoveOperatorTest
+
+/**
+ * @brief Test case to make sure the operators taking temporaries give the
+ *        right values and hand the temporary's storage on to the result.
+ */
+TEST_F(A4Test, MoveOperatorTest) {
+    const IntegerMatrix a = patterned<int>(9, 13, 1);
+    const IntegerMatrix b = patterned<int>(9, 13, 2);
+    const IntegerMatrix sum = a + b;
+    const IntegerMatrix difference = a - b;
+
+    IntegerMatrix l(a);
+    IntegerMatrix r(b);
+    const int *storage = l.rowData(0);
+    IntegerMatrix result = std::move(l) + b;
+    EXPECT_EQ(result.rowData(0), storage);
+    EXPECT_TRUE(result == sum);
+
+    storage = r.rowData(0);
+    result = a + std::move(r);
+    EXPECT_EQ(result.rowData(0), storage);
+    EXPECT_TRUE(result == sum);
+
+    l = a;
+    r = b;
+    storage = l.rowData(0);
+    result = std::move(l) + std::move(r);
+    EXPECT_EQ(result.rowData(0), storage);
+    EXPECT_TRUE(result == sum);
+
+    l = a;
+    storage = l.rowData(0);
+    result = std::move(l) - b;
+    EXPECT_EQ(result.rowData(0), storage);
+    EXPECT_TRUE(result == difference);
+
+    r = b;
+    storage = r.rowData(0);
+    result = a - std::move(r);
+    EXPECT_EQ(result.rowData(0), storage);
+    EXPECT_TRUE(result == difference);
+
+    l = a;
+    r = b;
+    storage = l.rowData(0);
+    result = std::move(l) - std::move(r);
+    EXPECT_EQ(result.rowData(0), storage);
+    EXPECT_TRUE(result == difference);
+
+    l = a;
+    storage = l.rowData(0);
+    result = std::move(l) * 3;
+    EXPECT_EQ(result.rowData(0), storage);
+    EXPECT_TRUE(result == IntegerMatrix(a * 3));
+
+    l = a;
+    storage = l.rowData(0);
+    result = 3 * std::move(l);
+    EXPECT_EQ(result.rowData(0), storage);
+    EXPECT_TRUE(result == IntegerMatrix(a * 3));
+
+    // A chain of temporaries keeps reusing the first one's storage
+    l = a;
+    storage = l.rowData(0);
+    result = std::move(l) + b - a + b;
+    EXPECT_EQ(result.rowData(0), storage);
+    EXPECT_TRUE(result == IntegerMatrix(sum + b - a));
+}
+
+#endif
+
+#ifdef RunStrassenTest
+
+/**
+ * @brief Strassen's product with a given crossover, for
+ *        expectProductMatchesReference
+ */
+struct StrassenProduct {
+    int crossover;
+
+    explicit StrassenProduct(int c) : crossover(c) {}
+
+    template <typename T>
+    Matrix<T> operator()(const Matrix<T> &a, const Matrix<T> &b) const {
+        return a.multiplyStrassen(b, crossover);
+    }
+};
+
+/**
+ * @brief Test case to make sure Strassen's product matches the reference
+ *        below, at and just past the crossover, and for odd sizes whose
+ *        extra row and column are peeled off at several levels.
+ */
+TEST_F(A4Test, StrassenTest) {
+    const int crossover = matrix_kernels::STRASSEN_CROSSOVER;
+    const int sizes[] = {1, 100, crossover, crossover + 1, 2 * crossover + 7};
+    for (int n : sizes) {
+        expectProductMatchesReference<int>(n, n, n,
+                                           StrassenProduct(crossover));
+        expectProductMatchesReference<double>(n, n, n,
+                                              StrassenProduct(crossover));
+    }
+    // A small crossover recurses several levels deep on odd sizes
+    expectProductMatchesReference<int>(101, 101, 101, StrassenProduct(8));
+    expectProductMatchesReference<double>(77, 77, 77, StrassenProduct(4));
+
+    IntegerMatrix a = patterned<int>(3, 5, 1);
+    IntegerMatrix b = patterned<int>(5, 2, 2);
+    EXPECT_TRUE(a.multiplyStrassen(b) == a.multiplyReference(b));
+    EXPECT_THROW(a.multiplyStrassen(a), IncompatibleMatrices);
+}
+
+#endif
+
+#ifdef RunSparseMatrixTest
+
+/**
+ * @brief Test case to make sure SparseMatrix converts to and from Matrix and
+ *        that its products and sums match the dense results.
+ */
+TEST_F(A4Test, SparseMatrixTest) {
+    IntegerMatrix m(2, 3);
+    m[0][1] = 4;
+    m[1][0] = 7;
+    m[1][2] = 5;
+
+    IntegerMatrix n(3, 2);
+    n[0][0] = 1;
+    n[1][1] = 2;
+    n[2][0] = 3;
+
+    SparseMatrix<int> sm(m);
+    SparseMatrix<int> sn(n, CSC);
+    EXPECT_EQ(sm.getNonZeros(), 3);
+    EXPECT_EQ(sm.at(1, 2), 5);
+    EXPECT_EQ(sm.at(0, 0), 0);
+    EXPECT_TRUE(sm.toDense() == m);
+    EXPECT_TRUE(sm == m);
+
+    IntegerMatrix product = m * n;
+    EXPECT_TRUE(sm * n == product);
+    EXPECT_TRUE(m * sn == product);
+    EXPECT_TRUE(sm * sn == product);
+
+    IntegerMatrix sum = m + m;
+    EXPECT_TRUE(sm + m == sum);
+    EXPECT_TRUE(m + sm == sum);
+
+    // Arrays that do not describe a valid 2 x 3 CSR matrix
+    typedef std::vector<int> Ints;
+    EXPECT_THROW(SparseMatrix<int>(2, 3, Ints{0, 1}, Ints{0}, Ints{1}),
+                 InvalidSparseStructure);
+    EXPECT_THROW(SparseMatrix<int>(2, 3, Ints{1, 1, 2}, Ints{0, 1},
+                                   Ints{1, 2}), InvalidSparseStructure);
+    EXPECT_THROW(SparseMatrix<int>(2, 3, Ints{0, 2, 1}, Ints{0, 1},
+                                   Ints{1, 2}), InvalidSparseStructure);
+    EXPECT_THROW(SparseMatrix<int>(2, 3, Ints{0, 1, 3}, Ints{0, 1},
+                                   Ints{1, 2}), InvalidSparseStructure);
+    EXPECT_THROW(SparseMatrix<int>(2, 3, Ints{0, 1, 2}, Ints{0, 1},
+                                   Ints{1}), InvalidSparseStructure);
+    EXPECT_THROW(SparseMatrix<int>(2, 3, Ints{0, 2, 2}, Ints{1, 0},
+                                   Ints{1, 2}), InvalidSparseStructure);
+    EXPECT_THROW(SparseMatrix<int>(2, 3, Ints{0, 2, 2}, Ints{1, 1},
+                                   Ints{1, 2}), InvalidSparseStructure);
+    EXPECT_THROW(SparseMatrix<int>(2, 3, Ints{0, 1, 2}, Ints{0, 3},
+                                   Ints{1, 2}), IndexOutOfBounds);
+    EXPECT_NO_THROW(SparseMatrix<int>(2, 3, Ints{0, 2, 2}, Ints{0, 2},
+                                      Ints{1, 2}));
+
+    MATCH_END(buff);
+    clearBuff(buff);
+}
+
+#endif
+
+#ifdef RunFixedMatrixTest
+
+/**
+ * @brief Test case to make sure FixedMatrix operations are evaluated at
+ *        compile time and agree with Matrix.
+ */
+TEST_F(A4Test, FixedMatrixTest) {
+    constexpr FixedMatrix<int, 2, 2> m = {{1, 2, 3, 4}};
+    constexpr FixedMatrix<int, 2, 2> n = {{3, 1, 7, 2}};
+    static_assert((m * n)(1, 1) == 11, "product must be a constant");
+    static_assert((m + n)(0, 0) == 4, "sum must be a constant");
+    static_assert((2 * m)(1, 0) == 6, "scalar product must be a constant");
+
+    IntegerMatrix dm = m;
+    IntegerMatrix dn = n;
+    IntegerMatrix product = dm * dn;
+    EXPECT_TRUE(IntegerMatrix(m * n) == product);
+    EXPECT_TRUE(m * dn == product);
+    EXPECT_TRUE((FixedMatrix<int, 2, 2>::fromMatrix(product) == m * n));
+
+    std::cout << m;
+    MATCH_NEXT_LINE(buff, "1 2");
+    MATCH_NEXT_LINE(buff, "3 4");
+    MATCH_END(buff);
+    clearBuff(buff);
+}
+
+#endif
+
+#ifdef RunBoundsCheckPolicyTest
+
+/**
+ * @brief Test case to make sure at() always checks its indices, operator()
+ *        never does, and the Check policy decides for bracket notation.
+ */
+TEST_F(A4Test, BoundsCheckPolicyTest) {
+    IntegerMatrix m(2, 3);
+    m.at(1, 2) = 5;
+    m(0, 1) = 7;
+    EXPECT_EQ(m[1][2], 5);
+    EXPECT_EQ(m(1, 2), 5);
+    EXPECT_EQ(m.at(0, 1), 7);
+    EXPECT_THROW(m.at(2, 0), IndexOutOfBounds);
+    EXPECT_THROW(m.at(0, 3), IndexOutOfBounds);
+    EXPECT_THROW(m[-1], IndexOutOfBounds);
+
+    Matrix<int, UncheckedAccess> u = m;
+    EXPECT_EQ(u[1][2], 5);
+    EXPECT_NO_THROW(u[2]);
+    EXPECT_THROW(u.at(2, 0), IndexOutOfBounds);
+
+    Matrix<int, UncheckedAccess> sum = u + u;
+    EXPECT_EQ(sum(1, 2), 10);
+    EXPECT_TRUE(IntegerMatrix(u) == m);
+
+    MATCH_END(buff);
+    clearBuff(buff);
+}
+
+#endif
+
+#ifdef RunTransposeTest
+
+/**
+ * @brief Test case to make sure transpose(), transposeInPlace() and the lazy
+ *        view returned by t() agree, including inside products.
+ */
+TEST_F(A4Test, TransposeTest) {
+    IntegerMatrix m(2, 3);
+    m[0][0] = 1;
+    m[0][1] = 2;
+    m[0][2] = 3;
+    m[1][0] = 4;
+    m[1][1] = 5;
+    m[1][2] = 6;
+
+    IntegerMatrix t = m.transpose();
+    EXPECT_EQ(t.getRows(), 3);
+    EXPECT_EQ(t.getCols(), 2);
+    EXPECT_EQ(t[2][1], 6);
+    EXPECT_TRUE(t == IntegerMatrix(m.t()));
+
+    // m^T * m without building m^T
+    IntegerMatrix g = m.t() * m;
+    EXPECT_TRUE(g == t * m);
+    EXPECT_TRUE(m * m.t() == m * t);
+
+    IntegerMatrix s = g;
+    s.transposeInPlace();
+    EXPECT_TRUE(s == g);
+    m.transposeInPlace();
+    EXPECT_TRUE(m == t);
+
+    std::cout << t;
+    MATCH_NEXT_LINE(buff, "1 4");
+    MATCH_NEXT_LINE(buff, "2 5");
+    MATCH_NEXT_LINE(buff, "3 6");
+    MATCH_END(buff);
+    clearBuff(buff);
+}
+
+#endif
+
+#ifdef RunViewTest
+
+/**
+ * @brief Detects whether t() and view() can be called on an M, which should
+ *        only be possible for lvalues
+ */
+template <typename M>
+auto hasViews(int) -> decltype(std::declval<M>().t(),
+                               std::declval<M>().view(0, 0, 1, 1),
+                               std::true_type());
+
+template <typename M>
+std::false_type hasViews(...);
+
+/**
+ * @brief Test case to make sure views read and write their parent's block
+ *        and take part in the operators.
+ */
+TEST_F(A4Test, ViewTest) {
+    IntegerMatrix m(3, 3);
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            m[i][j] = 3 * i + j;
+        }
+    }
+
+    IntegerMatrix n(2, 2);
+    n[0][0] = 1;
+    n[0][1] = 1;
+    n[1][0] = 1;
+    n[1][1] = 1;
+
+    auto v = m.view(1, 1, 2, 2);
+    EXPECT_EQ(v[0][0], 4);
+    EXPECT_EQ(v(1, 1), 8);
+
+    IntegerMatrix sum = v + n;
+    EXPECT_EQ(sum[1][0], 8);
+    IntegerMatrix product = v * n;
+    EXPECT_EQ(product[0][0], 9);
+    EXPECT_TRUE(v == IntegerMatrix(v));
+
+    v += n;
+    v[0][1] = 0;
+    EXPECT_EQ(m[1][1], 5);
+    EXPECT_EQ(m[1][2], 0);
+    EXPECT_THROW(m.view(2, 2, 2, 2), IndexOutOfBounds);
+    static_assert(decltype(hasViews<IntegerMatrix &>(0))::value,
+                  "views of lvalues must be allowed");
+    static_assert(decltype(hasViews<const IntegerMatrix &>(0))::value,
+                  "views of const lvalues must be allowed");
+    static_assert(!decltype(hasViews<IntegerMatrix>(0))::value,
+                  "views of temporaries must not compile");
+
+    std::cout << v;
+    MATCH_NEXT_LINE(buff, "5 0");
+    MATCH_NEXT_LINE(buff, "8 9");
+    MATCH_END(buff);
+    clearBuff(buff);
+}
+
+#endif
+
+#ifdef RunMatrixIOTest
+
+/**
+ * @brief Test case to make sure a saved matrix maps back with the same
+ *        elements, and that copy-on-write mappings never change the file.
+ */
+TEST_F(A4Test, MatrixIOTest) {
+    IntegerMatrix m(2, 3);
+    m[0][0] = 1;
+    m[0][1] = 2;
+    m[0][2] = 3;
+    m[1][0] = 4;
+    m[1][1] = 5;
+    m[1][2] = 6;
+    saveMatrix(m, "test_matrix.bin");
+
+    MappedMatrix<int> loaded = loadMatrix<int>("test_matrix.bin");
+    EXPECT_EQ(loaded.getRows(), 2);
+    EXPECT_EQ(loaded.getCols(), 3);
+    EXPECT_TRUE(IntegerMatrix(loaded) == m);
+    EXPECT_THROW(loaded.mutableView(), MatrixFileError);
+    EXPECT_THROW(loadMatrix<double>("test_matrix.bin"), MatrixFileError);
+
+    MappedMatrix<int> copy = loadMatrix<int>("test_matrix.bin", COPY_ON_WRITE);
+    copy.mutableView()[1][2] = 7;
+    EXPECT_EQ(copy.view()[1][2], 7);
+    EXPECT_TRUE(loadMatrix<int>("test_matrix.bin") == m);
+    std::remove("test_matrix.bin");
+
+    std::cout << loaded;
+    MATCH_NEXT_LINE(buff, "1 2 3");
+    MATCH_NEXT_LINE(buff, "4 5 6");
+    MATCH_END(buff);
+    clearBuff(buff);
+}
+
+#endif
+
+#ifdef RunBufferedPrintTest
+
+/**
+ * @brief Test case to make sure the buffered << operator prints exactly what
+ *        inserting each element does, with the stream's precision and flags,
+ *        and that row blocks formatted in parallel come out in order.
+ */
+TEST_F(A4Test, BufferedPrintTest) {
+    Matrix<double> m(2, 2);
+    m[0][0] = 1.0 / 3;
+    m[0][1] = -2.5e-7;
+    m[1][0] = 1e20;
+    m[1][1] = 0;
+    std::cout << m;
+    MATCH_NEXT_LINE(buff, "0.333333 -2.5e-07");
+    MATCH_NEXT_LINE(buff, "1e+20 0");
+    MATCH_END(buff);
+    clearBuff(buff);
+
+    std::cout.precision(3);
+    std::cout << m;
+    std::cout << std::fixed << m;
+    std::cout.precision(6);
+    std::cout.unsetf(std::ios::floatfield);
+    MATCH_NEXT_LINE(buff, "0.333 -2.5e-07");
+    MATCH_NEXT_LINE(buff, "1e+20 0");
+    MATCH_NEXT_LINE(buff, "0.333 -0.000");
+    MATCH_NEXT_LINE(buff, "100000000000000000000.000 0.000");
+    MATCH_END(buff);
+    clearBuff(buff);
+
+    std::complex<double> a(1.5, -2);
+    Matrix<std::complex<double>> c(1, 2);
+    c[0][0] = a;
+    c[0][1] = a * a;
+    std::cout << c;
+    MATCH_NEXT_LINE(buff, "(1.5,-2) (-1.75,-6)");
+    MATCH_END(buff);
+    clearBuff(buff);
+
+    IntegerMatrix big(500, 7);
+    std::stringstream expected;
+    for (int i = 0; i < 500; ++i) {
+        for (int j = 0; j < 7; ++j) {
+            big[i][j] = (i - 250) * 1000 + j;
+            expected << big[i][j] << (j == 6 ? "\n" : " ");
+        }
+    }
+    const int threads = getMatrixThreads();
+    const long cutoff = getMatrixPrintCutoff();
+    setMatrixThreads(4);
+    setMatrixPrintCutoff(1);
+    std::cout << big;
+    setMatrixThreads(threads);
+    setMatrixPrintCutoff(cutoff);
+    EXPECT_EQ(buff.str(), expected.str());
+    clearBuff(buff);
+
+    // printf follows the C locale, the stream does not: a decimal comma in
+    // LC_NUMERIC must not leak into the output (checked where one exists)
+    const std::string numeric = std::setlocale(LC_NUMERIC, nullptr);
+    const char *commaLocales[] = {"de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8",
+                                  "fr_FR.utf8", "de_DE", "fr_FR"};
+    for (const char *name : commaLocales) {
+        if (std::setlocale(LC_NUMERIC, name) != nullptr) {
+            std::cout << m;
+            MATCH_NEXT_LINE(buff, "0.333333 -2.5e-07");
+            MATCH_NEXT_LINE(buff, "1e+20 0");
+            MATCH_END(buff);
+            clearBuff(buff);
+            break;
+        }
+    }
+    std::setlocale(LC_NUMERIC, numeric.c_str());
+}
+
+#endif
+
+#ifdef RunPoolAllocatorTest
+
+/**
+ * @brief Test case to make sure matrices with a pool allocator behave like
+ *        any other matrix, and that a pool recycles buffers of the same size.
+ */
+TEST_F(A4Test, PoolAllocatorTest) {
+    MatrixPool pool;
+    EXPECT_EQ(MatrixPool::active(), &pool);
+
+    PooledMatrix<int> a(2, 2);
+    a[0][0] = 1;
+    a[0][1] = 2;
+    a[1][0] = 3;
+    a[1][1] = 4;
+    const int *storage;
+    {
+        PooledMatrix<int> b = a * a;
+        storage = b.rowData(0);
+        EXPECT_TRUE(b == IntegerMatrix(b));
+        std::cout << b + a;
+        MATCH_NEXT_LINE(buff, "8 12");
+        MATCH_NEXT_LINE(buff, "18 26");
+        MATCH_END(buff);
+        clearBuff(buff);
+    }
+    EXPECT_GT(pool.cachedBytes(), 0u);
+
+    PooledMatrix<int> c(2, 2);
+    EXPECT_EQ(c.rowData(0), storage);
+    EXPECT_EQ(pool.cachedBytes(), 0u);
+
+    {
+        MatrixPool inner(0);
+        EXPECT_EQ(MatrixPool::active(), &inner);
+        PooledMatrix<int> d(2, 2);
+    }
+    EXPECT_EQ(MatrixPool::active(), &pool);
+    EXPECT_EQ(pool.cachedBytes(), 0u);
+}
+
+#endif
+
+#ifdef RunComplexMultiplicationTest
+
+/**
+ * @brief Test case to make sure the split complex products (and the 3M
+ *        variant) agree with the textbook multiplication.
+ */
+TEST_F(A4Test, ComplexMultiplicationTest) {
+    typedef std::complex<double> C;
+    Matrix<C> a(40, 50);
+    Matrix<C> b(50, 30);
+    for (int i = 0; i < 40; ++i) {
+        for (int j = 0; j < 50; ++j) {
+            a[i][j] = C(i - j, (i * j) % 7);
+        }
+    }
+    for (int i = 0; i < 50; ++i) {
+        for (int j = 0; j < 30; ++j) {
+            b[i][j] = C(j % 5, i - 2 * j);
+        }
+    }
+    Matrix<C> expected = a.multiplyReference(b);
+    EXPECT_TRUE(a * b == expected);
+    EXPECT_TRUE(a.multiply3M(b) == expected);
+    EXPECT_TRUE(a.t().t() * b == expected);
+    EXPECT_THROW(b.multiply3M(b), IncompatibleMatrices);
+
+    // Spans several row, column and depth blocks of the planar split
+    Matrix<C> wide(133, 261);
+    Matrix<C> tall(261, 1030);
+    for (int i = 0; i < 133; ++i) {
+        for (int j = 0; j < 261; ++j) {
+            wide[i][j] = C((i + 2 * j) % 7 - 3, (i * j) % 5 - 2);
+        }
+    }
+    for (int i = 0; i < 261; ++i) {
+        for (int j = 0; j < 1030; ++j) {
+            tall[i][j] = C((3 * i + j) % 5 - 2, (i + j) % 3 - 1);
+        }
+    }
+    expected = wide.multiplyReference(tall);
+    EXPECT_TRUE(wide * tall == expected);
+    EXPECT_TRUE(wide.multiply3M(tall) == expected);
+    const Matrix<C> wideT = wide.transpose();
+    const Matrix<C> tallT = tall.transpose();
+    EXPECT_TRUE(wideT.t() * tallT.t() == expected);
+
+    Matrix<std::complex<int>> m(2, 2);
+    m[0][0] = std::complex<int>(1, 1);
+    m[0][1] = std::complex<int>(0, 2);
+    m[1][0] = std::complex<int>(3, 0);
+    m[1][1] = std::complex<int>(1, -1);
+    std::cout << m.multiply3M(m);
+    MATCH_NEXT_LINE(buff, "(0,8) (0,4)");
+    MATCH_NEXT_LINE(buff, "(6,0) (0,4)");
+    MATCH_END(buff);
+    clearBuff(buff);
+}
+
+#endif
+
+#ifdef RunMatrixVectorTest
+
+/**
+ * @brief Test case to make sure matrix-vector products (plain, transposed and
+ *        on raw arrays) match the equivalent N x 1 matrix products.
+ */
+TEST_F(A4Test, MatrixVectorTest) {
+    IntegerMatrix m(2, 3);
+    m[0][0] = 1;
+    m[0][1] = 2;
+    m[0][2] = 3;
+    m[1][0] = 4;
+    m[1][1] = 5;
+    m[1][2] = 6;
+    std::vector<int> x = {1, 0, -1};
+    std::vector<int> expected = {-2, -2};
+    EXPECT_EQ(m * x, expected);
+    EXPECT_THROW(m * expected, IncompatibleMatrices);
+
+    std::vector<int> xt = {1, 2};
+    expected = {9, 12, 15};
+    EXPECT_EQ(m.t() * xt, expected);
+    EXPECT_EQ(m.view(0, 1, 2, 2) * xt, std::vector<int>({8, 17}));
+
+    Matrix<double> big(300, 200);
+    Matrix<double> column(200, 1);
+    std::vector<double> v(200);
+    for (int i = 0; i < 300; ++i) {
+        for (int j = 0; j < 200; ++j) {
+            big[i][j] = (i * 7 + j * 3) % 11 - 5;
+        }
+    }
+    for (int j = 0; j < 200; ++j) {
+        v[j] = j % 9 - 4;
+        column[j][0] = v[j];
+    }
+    Matrix<double> product = big * column;
+    std::vector<double> y(300);
+    multiplyVector(big, v.data(), y.data());
+    for (int i = 0; i < 300; ++i) {
+        EXPECT_EQ(y[i], product[i][0]);
+    }
+}
+
+#endif
+
+#ifdef RunBatchedMultiplyTest
+
+/**
+ * @brief Test case to make sure batched products (arrays of matrices and
+ *        packed buffers, unrolled and general kernels) match operator*.
+ */
+TEST_F(A4Test, BatchedMultiplyTest) {
+    // Square 16 x 16 products take an unrolled kernel and, at this count,
+    // the thread pool
+    const int count = 1000;
+    std::vector<Matrix<double>> a(count, Matrix<double>(16, 16));
+    std::vector<Matrix<double>> b(count, Matrix<double>(16, 16));
+    // Empty outputs are given the product's shape
+    std::vector<Matrix<double>> c(count, Matrix<double>(0, 0));
+    for (int t = 0; t < count; ++t) {
+        for (int i = 0; i < 16; ++i) {
+            for (int j = 0; j < 16; ++j) {
+                a[t][i][j] = (t + i * 3 + j) % 7 - 3;
+                b[t][i][j] = (t * 2 + i + j * 5) % 5 - 2;
+            }
+        }
+    }
+    multiplyBatched(a.data(), b.data(), c.data(), count);
+    for (int t = 0; t < count; ++t) {
+        EXPECT_EQ(c[t], a[t] * b[t]);
+    }
+
+    // Rectangular products take the general kernel
+    std::vector<IntegerMatrix> l(3, IntegerMatrix(3, 5));
+    std::vector<IntegerMatrix> r(3, IntegerMatrix(5, 2));
+    std::vector<IntegerMatrix> p(3, IntegerMatrix(3, 2));
+    for (int t = 0; t < 3; ++t) {
+        for (int i = 0; i < 5; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                l[t][j][i] = t + i - j;
+            }
+            for (int j = 0; j < 2; ++j) {
+                r[t][i][j] = i * j - t;
+            }
+        }
+    }
+    multiplyBatched(l.data(), r.data(), p.data(), 3);
+    for (int t = 0; t < 3; ++t) {
+        EXPECT_EQ(p[t], l[t] * r[t]);
+    }
+    EXPECT_THROW(multiplyBatched(r.data(), l.data(), p.data(), 3),
+                 IncompatibleMatrices);
+
+    // Packed 4 x 4 operands
+    std::vector<int> x(10 * 16), y(10 * 16), z(10 * 16);
+    for (int i = 0; i < 10 * 16; ++i) {
+        x[i] = i % 9 - 4;
+        y[i] = i % 5;
+    }
+    multiplyBatched(10, 4, 4, 4, x.data(), y.data(), z.data());
+    for (int t = 0; t < 10; ++t) {
+        IntegerMatrix xm(4, 4), ym(4, 4);
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                xm[i][j] = x[t * 16 + i * 4 + j];
+                ym[i][j] = y[t * 16 + i * 4 + j];
+            }
+        }
+        IntegerMatrix zm = xm * ym;
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                EXPECT_EQ(z[t * 16 + i * 4 + j], zm[i][j]);
+            }
+        }
+    }
+}
+
+#endif
+
+#ifdef RunOutOfCoreMultiplyTest
+
+/**
+ * @brief Test case to make sure the tiled out-of-core product of two matrix
+ *        files matches the in-memory product, including when it replaces one
+ *        of its operands.
+ */
+TEST_F(A4Test, OutOfCoreMultiplyTest) {
+    Matrix<double> a(150, 90);
+    Matrix<double> b(90, 110);
+    for (int i = 0; i < 150; ++i) {
+        for (int j = 0; j < 90; ++j) {
+            a[i][j] = (i * 7 + j * 3) % 11 - 5;
+        }
+    }
+    for (int i = 0; i < 90; ++i) {
+        for (int j = 0; j < 110; ++j) {
+            b[i][j] = (i * 5 + j) % 9 - 4;
+        }
+    }
+    saveMatrix(a, "test_a.bin");
+    saveMatrix(b, "test_b.bin");
+
+    // A small budget splits the product into many tiles
+    multiplyMatrixFiles<double>("test_a.bin", "test_b.bin", "test_c.bin",
+                                40000);
+    EXPECT_TRUE(loadMatrix<double>("test_c.bin") == a * b);
+
+    multiplyMatrixFiles<double>("test_a.bin", "test_b.bin", "test_a.bin",
+                                40000);
+    EXPECT_TRUE(loadMatrix<double>("test_a.bin") == a * b);
+    EXPECT_THROW(multiplyToFile(b, b, "test_c.bin"), IncompatibleMatrices);
+
+    // A product that cannot be put in place leaves no partial file behind
+    mkdir("test_dir.bin", 0755);
+    EXPECT_THROW(multiplyToFile(a, b, "test_dir.bin", 40000), MatrixFileError);
+    EXPECT_NE(access("test_dir.bin.partial", F_OK), 0);
+    rmdir("test_dir.bin");
+    std::remove("test_a.bin");
+    std::remove("test_b.bin");
+    std::remove("test_c.bin");
+}
+
+#endif
+
+#ifdef RunLUTest
+
+/**
+ * @brief Test case to make sure the LU factorization solves systems, inverts
+ *        and takes determinants, and rejects singular and non-square matrices.
+ */
+TEST_F(A4Test, LUTest) {
+    Matrix<double> m(3, 3);
+    m[0][0] = 2;
+    m[0][1] = 1;
+    m[0][2] = 5;
+    m[1][0] = 1;
+    m[1][1] = 3;
+    m[2][2] = -4;
+    EXPECT_NEAR(determinant(m), -20, 1e-12);
+    std::vector<double> x = solve(m, std::vector<double>({8, 4, -4}));
+    EXPECT_NEAR(x[0], 1, 1e-12);
+    EXPECT_NEAR(x[1], 1, 1e-12);
+    EXPECT_NEAR(x[2], 1, 1e-12);
+
+    // Large enough for several panels and gemm trailing updates
+    const int n = 150;
+    Matrix<double> a(n, n);
+    Matrix<double> b(n, 2);
+    Matrix<double> identity(n, n);
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            a[i][j] = (i * 37 + j * 11) % 23 - 11 + (i == j ? 40 : 0);
+        }
+        b[i][0] = i % 5;
+        b[i][1] = -i;
+        identity[i][i] = 1;
+    }
+    LUDecomposition<double> lu(a);
+    Matrix<double> residual = a * lu.solve(b) - b;
+    Matrix<double> product = a * lu.inverse() - identity;
+    for (int i = 0; i < n; ++i) {
+        EXPECT_NEAR(residual[i][0], 0, 1e-9);
+        EXPECT_NEAR(residual[i][1], 0, 1e-9);
+        for (int j = 0; j < n; ++j) {
+            EXPECT_NEAR(product[i][j], 0, 1e-9);
+        }
+    }
+
+    Matrix<double> singular(2, 2);
+    singular[0][0] = 1;
+    singular[0][1] = 2;
+    singular[1][0] = 2;
+    singular[1][1] = 4;
+    EXPECT_EQ(determinant(singular), 0);
+    EXPECT_THROW(inverse(singular), SingularMatrix);
+    EXPECT_THROW(determinant(Matrix<double>(2, 3)), NonSquareMatrix);
+    try {
+        LUDecomposition<double> wide(Matrix<double>(2, 3));
+        ADD_FAILURE() << "a 2 x 3 matrix was factored";
+    } catch (const NonSquareMatrix &e) {
+        EXPECT_STREQ(e.what(), "Non-Square Matrix Exception: matrix with "
+                               "dimensions 2 x 3 is not square\n");
+    }
+    EXPECT_THROW(lu.solve(std::vector<double>(3)), IncompatibleMatrices);
+}
+
+#endif
+
+#ifdef RunMatrixPowerTest
+
+/**
+ * @brief Test case to make sure pow() matches repeated multiplication, for
+ *        dense, diagonal and complex matrices and the zero exponent.
+ */
+TEST_F(A4Test, MatrixPowerTest) {
+    IntegerMatrix fibonacci(2, 2);
+    fibonacci[0][0] = 1;
+    fibonacci[0][1] = 1;
+    fibonacci[1][0] = 1;
+    EXPECT_EQ(pow(fibonacci, 30)[0][1], 832040);
+
+    IntegerMatrix identity(2, 2);
+    identity[0][0] = 1;
+    identity[1][1] = 1;
+    IntegerMatrix repeated = identity;
+    for (unsigned k = 0; k < 12; ++k) {
+        EXPECT_EQ(pow(fibonacci, k), repeated);
+        repeated *= fibonacci;
+    }
+
+    IntegerMatrix diagonal(3, 3);
+    diagonal[0][0] = 2;
+    diagonal[1][1] = -3;
+    EXPECT_EQ(pow(diagonal, 5), diagonal * diagonal * diagonal * diagonal
+                                * diagonal);
+
+    Matrix<std::complex<double>> c(2, 2);
+    c[0][0] = std::complex<double>(0, 1);
+    c[0][1] = 1;
+    c[1][0] = 1;
+    EXPECT_EQ(pow(c, 3), c * c * c);
+    EXPECT_THROW(pow(IntegerMatrix(2, 3), 2), IncompatibleMatrices);
+}
+
+#endif
+
+#ifdef RunMatrixChainTest
+
+/**
+ * @brief Test case to make sure chains multiplied in the optimal order give
+ *        the left to right product, and that the order found is optimal.
+ */
+TEST_F(A4Test, MatrixChainTest) {
+    IntegerMatrix a(40, 3);
+    IntegerMatrix b(3, 40);
+    IntegerMatrix c(40, 3);
+    IntegerMatrix d(3, 7);
+    for (int i = 0; i < 40; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            a[i][j] = (i + j) % 5 - 2;
+            b[j][i] = (i * j) % 3 - 1;
+            c[i][j] = (i * 2 + j) % 7 - 3;
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 7; ++j) {
+            d[i][j] = i - j;
+        }
+    }
+    EXPECT_EQ(multiplyChain(a, b, c, d), a * b * c * d);
+    EXPECT_EQ(multiplyChain(std::vector<IntegerMatrix>({a, b, c})),
+              a * b * c);
+    EXPECT_EQ(multiplyChain({std::cref(b), std::cref(c), std::cref(d)}),
+              b * c * d);
+    EXPECT_EQ(multiplyChain(a), a);
+    EXPECT_THROW(multiplyChain(a, c), IncompatibleMatrices);
+    EXPECT_THROW(multiplyChain({std::cref(a), std::cref(c)}),
+                 IncompatibleMatrices);
+
+    // The textbook chain 30x35, 35x15, 15x5, 5x10, 10x20, 20x25
+    std::vector<int> split;
+    EXPECT_EQ(matrix_kernels::chainOrder({30, 35, 15, 5, 10, 20, 25}, split),
+              15125);
+    EXPECT_EQ(split[0 * 6 + 5], 2);
+}
+
+#endif
+
+#ifdef RunParallelElementwiseTest
+
+/**
+ * @brief Test case to make sure element-wise operations and comparisons split
+ *        across threads give the same results as on one thread.
+ */
+TEST_F(A4Test, ParallelElementwiseTest) {
+    Matrix<double> a(300, 50);
+    Matrix<double> b(300, 50);
+    for (int i = 0; i < 300; ++i) {
+        for (int j = 0; j < 50; ++j) {
+            a[i][j] = (i * 7 + j) % 13 - 6;
+            b[i][j] = (i + j * 5) % 11 - 5;
+        }
+    }
+    Matrix<double> sum = a + b * 2.0;
+    Matrix<double> compound = a;
+    compound -= b;
+    compound *= 3.0;
+
+    const int threads = getMatrixThreads();
+    const long cutoff = getMatrixElementwiseCutoff();
+    setMatrixThreads(4);
+    setMatrixElementwiseCutoff(1);
+    Matrix<double> parallelSum = a + b * 2.0;
+    Matrix<double> parallelCompound = a;
+    parallelCompound -= b;
+    parallelCompound *= 3.0;
+    Matrix<double> changed = a;
+    changed[299][49] += 1;
+    const bool same = parallelSum == sum && parallelCompound == compound
+                      && (a + b) == (b + a);
+    const bool different = changed == a || (changed + b) == (a + b);
+    setMatrixThreads(threads);
+    setMatrixElementwiseCutoff(cutoff);
+
+    EXPECT_TRUE(same);
+    EXPECT_FALSE(different);
+    for (int i = 0; i < 300; ++i) {
+        for (int j = 0; j < 50; ++j) {
+            EXPECT_EQ(parallelSum[i][j], sum[i][j]);
+            EXPECT_EQ(parallelCompound[i][j], compound[i][j]);
+        }
+    }
+}
+
+#endif
+
 /**
  * @brief Unit test execution begins here.
  *
@@ -4,7 +4,7 @@
 DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
 CODE_DIR=~gerald/public/html/cs368/assignments/a4
 LIB_DIR=/p/course/cs368-gerald/public/libraries
-VALID_ARGS=("BasicMatrixTest" "ConstMatrixTest" "BasicBracketTest" "ConstBracketTest" "BasicPrintTest" "ConstPrintTest" "BasicComparisonTest" "ConstComparisonTest" "MismatchedComparisonTest" "BasicAdditionTest" "ConstAdditionTest" "MismatchedAdditionTest" "BasicSubtractionTest" "BasicMatrixMultiplicationTest" "BasicScalarMultiplicationTest" "BasicCompoundAdditionTest" "ConstCompoundAdditionTest" "BasicCompoundSubtractionTest" "BasicCompoundMatrixMultiplicationTest" "BasicCompoundScalarMultiplicationTest" "ComplexTest")
+VALID_ARGS=("BasicMatrixTest" "ConstMatrixTest" "BasicBracketTest" "ConstBracketTest" "BasicPrintTest" "ConstPrintTest" "BasicComparisonTest" "ConstComparisonTest" "MismatchedComparisonTest" "BasicAdditionTest" "ConstAdditionTest" "MismatchedAdditionTest" "BasicSubtractionTest" "BasicMatrixMultiplicationTest" "BasicScalarMultiplicationTest" "BasicCompoundAdditionTest" "ConstCompoundAdditionTest" "BasicCompoundSubtractionTest" "BasicCompoundMatrixMultiplicationTest" "BasicCompoundScalarMultiplicationTest" "ComplexTest" "GemmKernelTest" "SimdTailTest" "ParallelGemmTest" "FusedExpressionTest" "MoveOperatorTest" "StrassenTest" "SparseMatrixTest" "FixedMatrixTest" "BoundsCheckPolicyTest" "TransposeTest" "ViewTest" "MatrixIOTest" "BufferedPrintTest" "PoolAllocatorTest" "ComplexMultiplicationTest" "MatrixVectorTest" "BatchedMultiplyTest" "OutOfCoreMultiplyTest" "LUTest" "MatrixPowerTest" "MatrixChainTest" "ParallelElementwiseTest")
 
 cd $DIR
 
@@ -131,7 +131,7 @@ for arg in "$@"; do
             output=$(g++ -std=c++11 -D "$arg0" -D "$arg1" -isystem $INCLUDE -pthread $FILES -o ./test 2>&1 > /dev/null)
             if [ -z "$output" ]; then
                 (<&2 echo "$arg should not have compiled")
-            elif [ -z "$(echo "$output" | grep 'error: passing .const .*. as .this. argument of .*::operator=.* discards qualifiers')" ]; then
+            elif [ -z "$(echo "$output" | grep -E 'error: (passing .const .*. as .this. argument of .*::operator=.* discards qualifiers|no match for .operator=. \(operand types are )')" ]; then
                 (<&2 echo "$output")
                 (<&2 echo "Expected $arg to raise a compiler error, but got the wrong compiler error")
             else